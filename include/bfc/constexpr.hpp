@@ -0,0 +1,242 @@
+/*
+Header only brainfuck engine, for embedding small programs in C++ without running bfc or linking llvm.
+
+    bfc::program<"++++++++[>++++++++<-]>+.">::run(); // prints "A"
+
+    constexpr auto output = bfc::evaluate<"++++++++[>++++++++<-]>+.">(); // "A", at compile time
+    static_assert(output.view() == "A");
+
+Programs are parsed at compile time, with the same grammar as bfc's Parser, into a sequence of ops, with
+runs of +/- and </> folded, and [-]/[+] recognised as clearing the cell. Each op is then instantiated as
+straight-line code, so nothing is left to parse or interpret at run time.
+*/
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace bfc {
+
+// as bfc's generator
+inline constexpr size_t DEFAULT_TAPE_SIZE = 255;
+
+// a string literal usable as a template argument
+template <size_t N>
+struct fixed_string {
+    constexpr fixed_string() = default;
+
+    constexpr fixed_string(const char (&str)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            data[i] = str[i];
+        }
+    }
+
+    constexpr std::string_view view() const {
+        return {data, N - 1};
+    }
+
+    char data[N] {};
+};
+
+template <size_t TapeSize = DEFAULT_TAPE_SIZE>
+struct tape {
+    std::array<uint8_t, TapeSize> cells {};
+    size_t head = 0;
+};
+
+namespace detail {
+
+enum class OpKind {
+    ADD, // add arg to the cell
+    MOVE, // move the head by arg
+    READ,
+    PRINT,
+    CLEAR, // [-] or [+]
+    LOOP, // match is the index of the loop's END
+    END
+};
+
+struct Op {
+    OpKind kind;
+    int arg = 0;
+    size_t match = 0;
+};
+
+// there are never more ops than characters
+template <size_t N>
+struct OpSequence {
+    std::array<Op, N> ops {};
+    size_t size = 0;
+};
+
+template <size_t N>
+constexpr OpSequence<N> parse(std::string_view source) {
+    OpSequence<N> seq;
+
+    // indices of the LOOPs still waiting for their END
+    std::array<size_t, N> open {};
+    size_t depth = 0;
+
+    auto fold = [&](OpKind kind, int arg) {
+        if (seq.size > 0 && seq.ops[seq.size - 1].kind == kind) {
+            seq.ops[seq.size - 1].arg += arg;
+        } else {
+            seq.ops[seq.size++] = {kind, arg};
+        }
+    };
+
+    for (char c : source) {
+        switch (c) {
+        case '+':
+            fold(OpKind::ADD, 1);
+            break;
+        case '-':
+            fold(OpKind::ADD, -1);
+            break;
+        case '<':
+            fold(OpKind::MOVE, -1);
+            break;
+        case '>':
+            fold(OpKind::MOVE, 1);
+            break;
+        case ',':
+            seq.ops[seq.size++] = {OpKind::READ};
+            break;
+        case '.':
+            seq.ops[seq.size++] = {OpKind::PRINT};
+            break;
+        case '[':
+            open[depth++] = seq.size;
+            seq.ops[seq.size++] = {OpKind::LOOP};
+            break;
+        case ']': {
+            if (depth == 0) {
+                throw std::runtime_error("Unexpected \"]\" token");
+            }
+
+            size_t begin = open[--depth];
+            const Op& body = seq.ops[begin + 1];
+
+            if (seq.size == begin + 2 && body.kind == OpKind::ADD && (body.arg == 1 || body.arg == -1)) {
+                seq.size = begin;
+                seq.ops[seq.size++] = {OpKind::CLEAR};
+            } else {
+                seq.ops[begin].match = seq.size;
+                seq.ops[seq.size++] = {OpKind::END, 0, begin};
+            }
+            break;
+        }
+        default:
+            break; // anything else is a comment
+        }
+    }
+
+    if (depth != 0) {
+        throw std::runtime_error("Unexpected end of program, expected \"]\"");
+    }
+
+    return seq;
+}
+
+} // namespace detail
+
+template <fixed_string Source>
+class program {
+    static constexpr detail::OpSequence<sizeof(Source.data)> parsed_ = detail::parse<sizeof(Source.data)>(Source.view());
+
+public:
+    // input returns the next character, or a negative value at the end of input, which reads as 0
+    // output is called with each printed character
+    template <size_t TapeSize, typename Input, typename Output>
+    static constexpr void run(tape<TapeSize>& tape, Input&& input, Output&& output) {
+        run_range<0, parsed_.size>(tape, input, output);
+    }
+
+    // runs on a fresh tape, using stdin and stdout
+    static void run() {
+        bfc::tape<> tape;
+        run(tape, [] { return std::getchar(); }, [](char c) { std::putchar(c); });
+    }
+
+protected:
+    // index of the op following the one at i, skipping over loop bodies
+    static constexpr size_t next(size_t i) {
+        return parsed_.ops[i].kind == detail::OpKind::LOOP ? parsed_.ops[i].match + 1 : i + 1;
+    }
+
+    // indices of the ops in [Begin, End) that are not nested in a loop within the range
+    template <size_t Begin, size_t End>
+    static constexpr auto top_level_indices() {
+        constexpr size_t count = [] {
+            size_t count = 0;
+            for (size_t i = Begin; i < End; i = next(i)) {
+                ++count;
+            }
+            return count;
+        }();
+
+        std::array<size_t, count> indices {};
+        for (size_t i = Begin, k = 0; i < End; i = next(i), ++k) {
+            indices[k] = i;
+        }
+        return indices;
+    }
+
+    template <size_t Begin, size_t End, size_t TapeSize, typename Input, typename Output>
+    static constexpr void run_range(tape<TapeSize>& tape, Input& input, Output& output) {
+        constexpr auto indices = top_level_indices<Begin, End>();
+
+        [&]<size_t... K>(std::index_sequence<K...>) {
+            (run_op<indices[K]>(tape, input, output), ...);
+        }(std::make_index_sequence<indices.size()>{});
+    }
+
+    template <size_t I, size_t TapeSize, typename Input, typename Output>
+    static constexpr void run_op(tape<TapeSize>& tape, Input& input, Output& output) {
+        constexpr detail::Op op = parsed_.ops[I];
+
+        if constexpr (op.kind == detail::OpKind::ADD) {
+            tape.cells[tape.head] += static_cast<uint8_t>(op.arg);
+        } else if constexpr (op.kind == detail::OpKind::MOVE) {
+            tape.head += static_cast<size_t>(static_cast<std::ptrdiff_t>(op.arg));
+        } else if constexpr (op.kind == detail::OpKind::READ) {
+            int c = input();
+            tape.cells[tape.head] = c < 0 ? 0 : static_cast<uint8_t>(c);
+        } else if constexpr (op.kind == detail::OpKind::PRINT) {
+            output(static_cast<char>(tape.cells[tape.head]));
+        } else if constexpr (op.kind == detail::OpKind::CLEAR) {
+            tape.cells[tape.head] = 0;
+        } else if constexpr (op.kind == detail::OpKind::LOOP) {
+            while (tape.cells[tape.head] != 0) {
+                run_range<I + 1, op.match>(tape, input, output);
+            }
+        }
+    }
+};
+
+// runs an input free program at compile time, returning its output
+template <fixed_string Source, size_t TapeSize = DEFAULT_TAPE_SIZE>
+consteval auto evaluate() {
+    auto no_input = []() -> int {
+        throw std::runtime_error("Input is not available at compile time");
+    };
+
+    constexpr size_t size = [no_input] {
+        size_t size = 0;
+        tape<TapeSize> tape;
+        program<Source>::run(tape, no_input, [&size](char) { ++size; });
+        return size;
+    }();
+
+    fixed_string<size + 1> output;
+    size_t i = 0;
+    tape<TapeSize> tape;
+    program<Source>::run(tape, no_input, [&](char c) { output.data[i++] = c; });
+    return output;
+}
+
+} // namespace bfc
@@ -3,10 +3,10 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
-#include "generator.hpp"
+#include "visitor.hpp"
 
-void Program::accept(Generator& generator) const {
-    generator.visit(this);
+void Program::accept(Visitor& visitor) const {
+    visitor.visit(this);
 }
 
 Program::operator std::string() const {
@@ -15,9 +15,30 @@ Program::operator std::string() const {
     return ss.str();
 }
 
-void FullStmtList::accept(Generator& generator) const {
-    stmt->accept(generator);
-    next->accept(generator); // recurse
+// unlink the rest of the list iteratively, since the default recursive 
+// destruction would overflow the stack for long programs
+FullStmtList::~FullStmtList() {
+    std::unique_ptr<StmtList> rest = std::move(next);
+    while (FullStmtList* full = dynamic_cast<FullStmtList*>(rest.get())) {
+        std::unique_ptr<StmtList> after = std::move(full->next);
+        rest = std::move(after);
+    }
+}
+
+void FullStmtList::accept(Visitor& visitor) const {
+    visitor.visit(*this);
+}
+
+size_t FullStmtList::size() const {
+    size_t size = 0;
+    for (const FullStmtList* stmt_list = this; stmt_list; stmt_list = stmt_list->next_full()) {
+        size += stmt_list->stmt->size();
+    }
+    return size;
+}
+
+const FullStmtList* FullStmtList::next_full() const {
+    return dynamic_cast<const FullStmtList*>(next.get());
 }
 
 FullStmtList::operator std::string() const {
@@ -26,54 +47,69 @@ FullStmtList::operator std::string() const {
     return ss.str();
 }
 
-void EmptyStmtList::accept(Generator& generator) const {}
+void EmptyStmtList::accept(Visitor& visitor) const {}
 
 EmptyStmtList::operator std::string() const {
     return "EmptyStmtList";
 }
 
-void LeftStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void LeftStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
 }
 
 LeftStmt::operator std::string() const {
     return "<";
 }
 
-void RightStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void RightStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
 }
 
 RightStmt::operator std::string() const {
     return ">";
 }
 
-void IncStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void IncStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
 }
 
 IncStmt::operator std::string() const {
     return "+";
 }
 
-void DecStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void DecStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
 }
 
 DecStmt::operator std::string() const {
     return "-";
 }
 
-void PrintStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void ReadStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
+}
+
+ReadStmt::operator std::string() const {
+    return ",";
+}
+
+void PrintStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
 }
 
 PrintStmt::operator std::string() const {
     return ".";
 }
 
-void LoopStmt::accept(Generator& generator) const {
-    generator.visit(*this);
+void LoopStmt::accept(Visitor& visitor) const {
+    visitor.visit(*this);
+}
+
+size_t LoopStmt::size() const {
+    if (size_ == 0) {
+        size_ = 1 + stmt_list->size();
+    }
+    return size_;
 }
 
 LoopStmt::operator std::string() const {
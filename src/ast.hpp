@@ -7,13 +7,13 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 
-class Generator;
+class Visitor;
 class StmtList;
 class Stmt;
 
 class AST {
 public:
-    virtual void accept(Generator& visitor) const {}
+    virtual void accept(Visitor& visitor) const {}
 
     virtual operator std::string() const = 0;
 
@@ -25,40 +25,43 @@ public:
 // Stmt
 struct Stmt : public AST {
     virtual ~Stmt() = default;
+
+    // number of statements, including those nested in loops
+    virtual size_t size() const { return 1; }
 };
 
 struct LeftStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
 
 struct RightStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
 
 struct IncStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
 
 struct DecStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
 
 struct ReadStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
 
 struct PrintStmt : public Stmt {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 };
@@ -66,15 +69,23 @@ struct PrintStmt : public Stmt {
 struct LoopStmt : public Stmt {
     LoopStmt(std::unique_ptr<StmtList> stmt_list) : stmt_list{std::move(stmt_list)} {}
 
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 
+    size_t size() const override;
+
     std::unique_ptr<StmtList> stmt_list;
+
+protected:
+    mutable size_t size_ = 0; // memoized, 0 until computed
 };
 
 struct StmtList : public AST {
     virtual ~StmtList() = default;
+
+    // number of statements, including those nested in loops
+    virtual size_t size() const = 0;
 };
 
 struct FullStmtList : public StmtList {
@@ -82,24 +93,33 @@ struct FullStmtList : public StmtList {
         stmt{std::move(stmt)},
         next{std::move(next)} {}
 
-    void accept(Generator& visitor) const override;
+    ~FullStmtList() override;
+
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 
+    size_t size() const override;
+
+    // the following node, or nullptr at the end of the list
+    const FullStmtList* next_full() const;
+
     std::unique_ptr<Stmt> stmt;
     std::unique_ptr<StmtList> next;
 };
 
 struct EmptyStmtList : public StmtList {
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
+
+    size_t size() const override { return 0; }
 };
 
 struct Program : public AST {
     explicit Program(std::unique_ptr<StmtList> stmt_list) : stmt_list{std::move(stmt_list)} {}
 
-    void accept(Generator& visitor) const override;
+    void accept(Visitor& visitor) const override;
 
     operator std::string() const override;
 
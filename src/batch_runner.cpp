@@ -0,0 +1,196 @@
+#include "batch_runner.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
+#include <llvm/TargetParser/Triple.h>
+
+#include "compiler.hpp"
+#include "ostream_to_llvm_raw_pwrite_stream_adaptor.hpp"
+#include "output.hpp"
+
+void BatchRunner::compile(std::string_view source, const Compiler::Options& options) {
+
+    // go through the library, so runs see the same program bfc would otherwise emit
+    Compiler::Options bitcode_options = options;
+    bitcode_options.output_type = Compiler::OutputType::LLVM_BITCODE;
+
+    Compiler compiler;
+    std::string bitcode = compiler.compile(source, bitcode_options);
+
+    // the jit owns the module, so it is read back into a context of its own
+    auto context = std::make_unique<llvm::LLVMContext>();
+    llvm::Expected<std::unique_ptr<llvm::Module>> module_ = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(bitcode, "bfc"), *context
+    );
+    if (!module_) {
+        throw std::runtime_error("Failed to read generated module: " + llvm::toString(module_.takeError()));
+    }
+
+    // programs only ever run on the host
+    std::string target_triple = llvm::sys::getProcessTriple();
+    Compiler::initialize_target(target_triple);
+
+    llvm::orc::JITTargetMachineBuilder machine_builder {llvm::Triple(target_triple)};
+    machine_builder.setCPU(LLVMModuleEmitter::resolve_cpu(options.cpu));
+    machine_builder.getFeatures() = llvm::SubtargetFeatures(LLVMModuleEmitter::resolve_features(options.cpu, options.features));
+
+    llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder()
+        .setJITTargetMachineBuilder(std::move(machine_builder))
+        .create();
+    if (!jit) {
+        throw std::runtime_error("Failed to start the JIT: " + llvm::toString(jit.takeError()));
+    }
+    jit_ = std::move(*jit);
+
+    // putchar, getchar etc. resolve to this process's libc
+    auto process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit_->getDataLayout().getGlobalPrefix()
+    );
+    if (!process_symbols) {
+        throw std::runtime_error("Failed to resolve process symbols: " + llvm::toString(process_symbols.takeError()));
+    }
+    jit_->getMainJITDylib().addGenerator(std::move(*process_symbols));
+
+    if (llvm::Error err = jit_->addIRModule(llvm::orc::ThreadSafeModule(std::move(*module_), std::move(context)))) {
+        throw std::runtime_error("Failed to add module to the JIT: " + llvm::toString(std::move(err)));
+    }
+
+    // looking main up compiles it, before any worker is forked
+    auto main_addr = jit_->lookup("main");
+    if (!main_addr) {
+        throw std::runtime_error("Failed to compile main: " + llvm::toString(main_addr.takeError()));
+    }
+    main_func_ = main_addr->toPtr<int (*)()>();
+}
+
+size_t BatchRunner::run(const std::vector<std::string>& input_file_names) {
+    if (!main_func_) {
+        throw std::runtime_error("No program has been compiled");
+    }
+
+    // concurrent runs must never write to the same output files
+    std::unordered_set<std::string> output_paths;
+    for (const std::string& input_file_name : input_file_names) {
+        std::string path = output_path(input_file_name);
+        if (!output_paths.insert(path).second) {
+            throw std::runtime_error("More than one input would write to \"" + path + ".stdout\", inputs must have distinct file names");
+        }
+    }
+
+    size_t job_count = std::max<size_t>(job_count_, 1);
+    size_t failed = 0;
+
+    // input file name of each running worker
+    std::unordered_map<pid_t, std::string> running;
+
+    auto wait_for_one = [&] {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            return;
+        }
+
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            return;
+        }
+
+        if (WIFSIGNALED(status)) {
+            std::cerr << '"' << it->second << "\": killed by signal " << WTERMSIG(status) << '\n';
+            ++failed;
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            std::cerr << '"' << it->second << "\": exited with status " << WEXITSTATUS(status) << '\n';
+            ++failed;
+        }
+
+        running.erase(it);
+    };
+
+    for (const std::string& input_file_name : input_file_names) {
+        while (running.size() >= job_count) {
+            wait_for_one();
+        }
+
+        pid_t pid = spawn(input_file_name);
+        if (pid < 0) {
+            std::cerr << '"' << input_file_name << "\": failed to start a worker\n";
+            ++failed;
+            continue;
+        }
+        running.emplace(pid, input_file_name);
+    }
+
+    while (!running.empty()) {
+        wait_for_one();
+    }
+
+    return failed;
+}
+
+std::string BatchRunner::output_path(const std::string& input_file_name) const {
+    return output_dir_ + "/" + input_file_name.substr(input_file_name.find_last_of('/') + 1);
+}
+
+pid_t BatchRunner::spawn(const std::string& input_file_name) {
+
+    // anything still buffered would otherwise be written by every worker too
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    std::string output_path = this->output_path(input_file_name);
+
+    int input_fd = open(input_file_name.c_str(), O_RDONLY);
+    int stdout_fd = open((output_path + ".stdout").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int stderr_fd = open((output_path + ".stderr").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (input_fd < 0 || stdout_fd < 0 || stderr_fd < 0) {
+        std::fprintf(stderr, "\"%s\": failed to open input or output files\n", input_file_name.c_str());
+        _exit(126);
+    }
+
+    dup2(input_fd, STDIN_FILENO);
+    dup2(stdout_fd, STDOUT_FILENO);
+    dup2(stderr_fd, STDERR_FILENO);
+    close(input_fd);
+    close(stdout_fd);
+    close(stderr_fd);
+
+    // stdin may have already hit the end of the program's source
+    std::clearerr(stdin);
+
+    int ret = main_func_();
+
+    // exit without running the parent's destructors or atexit handlers
+    std::fflush(nullptr);
+    _exit(ret);
+}
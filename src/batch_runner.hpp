@@ -0,0 +1,46 @@
+/*
+Runs one program over many inputs, e.g. a filter over thousands of files.
+
+The program is compiled once, in process, by llvm's JIT. Each input is then run by a worker forked from
+the compiled process, so no run pays for exec, dynamic linking or compilation again. A worker's stdin is
+its input file, and its stdout and stderr are captured to <input name>.stdout and <input name>.stderr.
+*/
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+
+#include "compiler.hpp"
+
+class BatchRunner {
+public:
+    BatchRunner(std::string output_dir, size_t job_count) :
+        output_dir_{std::move(output_dir)},
+        job_count_{job_count} {}
+
+    // throws std::runtime_error if the source fails to compile
+    void compile(std::string_view source, const Compiler::Options& options);
+
+    // runs at most job_count inputs at a time, returns the number of runs that failed
+    // throws std::runtime_error if two inputs share a file name, since their outputs would collide
+    size_t run(const std::vector<std::string>& input_file_names);
+
+protected:
+    // outputs are named after the input file, without its directory, as <path>.stdout and <path>.stderr
+    std::string output_path(const std::string& input_file_name) const;
+
+    // only returns to the parent, the worker exits once the program has run
+    pid_t spawn(const std::string& input_file_name);
+
+    std::string output_dir_;
+    size_t job_count_;
+
+    std::unique_ptr<llvm::orc::LLJIT> jit_;
+    int (*main_func_)() = nullptr;
+};
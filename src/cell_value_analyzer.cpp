@@ -0,0 +1,211 @@
+#include "cell_value_analyzer.hpp"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include "ast.hpp"
+
+namespace {
+
+// collects the offsets written by a balanced loop's body, every loop nested in which is balanced too
+class WrittenOffsetCollector : public Visitor {
+public:
+    WrittenOffsetCollector(CellValueAnalyzer& analyzer, std::set<long>& written) :
+        analyzer_{analyzer},
+        written_{written} {}
+
+    void visit(const Program* prog) override {}
+
+    void visit(const FullStmtList& stmt_list) override {
+        for (const FullStmtList* it = &stmt_list; it; it = it->next_full()) {
+            it->stmt->accept(*this);
+        }
+    }
+
+    void visit(const LeftStmt& stmt) override { --offset_; }
+
+    void visit(const RightStmt& stmt) override { ++offset_; }
+
+    void visit(const IncStmt& stmt) override { written_.insert(offset_); }
+
+    void visit(const DecStmt& stmt) override { written_.insert(offset_); }
+
+    void visit(const ReadStmt& stmt) override { written_.insert(offset_); }
+
+    void visit(const PrintStmt& stmt) override {}
+
+    void visit(const LoopStmt& stmt) override {
+        written_.insert(offset_); // zeroed on exit
+        for (long offset : analyzer_.written_offsets(stmt)) {
+            written_.insert(offset_ + offset);
+        }
+    }
+
+protected:
+    CellValueAnalyzer& analyzer_;
+    std::set<long>& written_;
+    long offset_ = 0;
+};
+
+} // namespace
+
+void CellValueAnalyzer::set_partial_evaluation(const PartialEvaluation* evaluation) {
+    evaluation_ = evaluation;
+}
+
+bool CellValueAnalyzer::is_dead(const LoopStmt& stmt) const {
+    return dead_loops_.count(&stmt) > 0;
+}
+
+std::optional<uint8_t> CellValueAnalyzer::known_result(const Stmt& stmt) const {
+    auto it = known_results_.find(&stmt);
+    if (it == known_results_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool CellValueAnalyzer::is_superseded(const Stmt& stmt) const {
+    return superseded_.count(&stmt) > 0;
+}
+
+const std::set<long>& CellValueAnalyzer::written_offsets(const LoopStmt& stmt) {
+    auto it = written_offsets_.find(&stmt);
+    if (it != written_offsets_.end()) {
+        return it->second;
+    }
+
+    std::set<long> written;
+    WrittenOffsetCollector collector (*this, written);
+    stmt.stmt_list->accept(collector);
+
+    return written_offsets_.emplace(&stmt, std::move(written)).first->second;
+}
+
+void CellValueAnalyzer::visit(const Program* prog) {
+    const StmtList* stmt_list = prog->stmt_list.get();
+
+    if (evaluation_) {
+        stmt_list = evaluation_->residual;
+        if (!stmt_list) {
+            return;
+        }
+
+        // the evaluated tape is fully known, relative to the evaluated head
+        rest_zero_ = false;
+        for (size_t i = 0; i < evaluation_->tape.size(); ++i) {
+            set_cell(static_cast<long>(i) - static_cast<long>(evaluation_->head), evaluation_->tape[i]);
+        }
+    }
+
+    stmt_list->accept(*this);
+}
+
+void CellValueAnalyzer::visit(const FullStmtList& stmt_list) {
+    for (const FullStmtList* it = &stmt_list; it; it = it->next_full()) {
+        it->stmt->accept(*this);
+    }
+}
+
+void CellValueAnalyzer::visit(const LeftStmt& stmt) {
+    last_known_stmt_ = nullptr;
+    --offset_;
+}
+
+void CellValueAnalyzer::visit(const RightStmt& stmt) {
+    last_known_stmt_ = nullptr;
+    ++offset_;
+}
+
+void CellValueAnalyzer::visit(const IncStmt& stmt) {
+    add_to_cell(stmt, 1);
+}
+
+void CellValueAnalyzer::visit(const DecStmt& stmt) {
+    add_to_cell(stmt, -1);
+}
+
+void CellValueAnalyzer::visit(const ReadStmt& stmt) {
+    last_known_stmt_ = nullptr;
+    set_cell(offset_, std::nullopt);
+}
+
+void CellValueAnalyzer::visit(const PrintStmt& stmt) {
+    last_known_stmt_ = nullptr;
+}
+
+void CellValueAnalyzer::visit(const LoopStmt& stmt) {
+
+    // the loop reads its cell, both on entry and after its body
+    last_known_stmt_ = nullptr;
+
+    if (get_cell(offset_) == 0) {
+        dead_loops_.insert(&stmt);
+        return;
+    }
+
+    if (head_move_analyzer_.is_balanced(stmt)) {
+
+        // every iteration starts from the same head, with the cells the body never writes unchanged
+        for (long offset : written_offsets(stmt)) {
+            set_cell(offset_ + offset, std::nullopt);
+        }
+
+        long offset = offset_;
+        std::map<long, std::optional<uint8_t>> cells = cells_;
+        bool rest_zero = rest_zero_;
+
+        stmt.stmt_list->accept(*this);
+
+        offset_ = offset;
+        cells_ = std::move(cells);
+        rest_zero_ = rest_zero;
+    } else {
+        forget_all();
+        stmt.stmt_list->accept(*this);
+        forget_all();
+    }
+
+    last_known_stmt_ = nullptr;
+    set_cell(offset_, 0);
+}
+
+std::optional<uint8_t> CellValueAnalyzer::get_cell(long offset) const {
+    auto it = cells_.find(offset);
+    if (it != cells_.end()) {
+        return it->second;
+    }
+
+    if (rest_zero_) {
+        return 0;
+    }
+    return std::nullopt;
+}
+
+void CellValueAnalyzer::set_cell(long offset, std::optional<uint8_t> value) {
+    cells_[offset] = value;
+}
+
+void CellValueAnalyzer::add_to_cell(const Stmt& stmt, uint8_t delta) {
+    std::optional<uint8_t> value = get_cell(offset_);
+    if (!value) {
+        last_known_stmt_ = nullptr;
+        return;
+    }
+
+    // the head has not moved since the previous statement, so this stores over its result
+    if (last_known_stmt_) {
+        superseded_.insert(last_known_stmt_);
+    }
+    last_known_stmt_ = &stmt;
+
+    uint8_t result = *value + delta;
+    known_results_[&stmt] = result;
+    set_cell(offset_, result);
+}
+
+void CellValueAnalyzer::forget_all() {
+    offset_ = 0;
+    cells_.clear();
+    rest_zero_ = false;
+}
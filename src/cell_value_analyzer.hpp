@@ -0,0 +1,85 @@
+/*
+Tracks which tape cells hold known values, across straight-line code and loop exits, since llvm
+cannot see through the tape memory to do so itself.
+
+Every cell starts as zero (or as left by the partial evaluator), and a loop always exits with its
+cell at zero. A balanced loop only forgets the cells its body writes, any other loop loses track of
+where the head is, and so forgets everything. Loops whose cell is known to be zero never run, and
++/- statements whose cell is known become constant stores, of which a run on the same cell only
+needs the last.
+*/
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast.hpp"
+#include "visitor.hpp"
+#include "partial_evaluator.hpp"
+#include "head_move_analyzer.hpp"
+
+class CellValueAnalyzer : public Visitor {
+public:
+    // start from the state left by evaluating the program's prefix at compile time
+    void set_partial_evaluation(const PartialEvaluation* evaluation);
+
+    // the loop's cell is zero whenever the loop is reached
+    bool is_dead(const LoopStmt& stmt) const;
+
+    // the value a +/- statement always leaves in its cell
+    std::optional<uint8_t> known_result(const Stmt& stmt) const;
+
+    // a +/- statement of known result, immediately followed by another on the same cell,
+    // which stores over it before anything can read the cell
+    bool is_superseded(const Stmt& stmt) const;
+
+    // offsets from the head written by any iteration of a balanced loop
+    const std::set<long>& written_offsets(const LoopStmt& stmt);
+
+    void visit(const Program* prog) override;
+
+    void visit(const FullStmtList& stmt_list) override;
+
+    void visit(const LeftStmt& stmt) override;
+
+    void visit(const RightStmt& stmt) override;
+
+    void visit(const IncStmt& stmt) override;
+
+    void visit(const DecStmt& stmt) override;
+
+    void visit(const ReadStmt& stmt) override;
+
+    void visit(const PrintStmt& stmt) override;
+
+    void visit(const LoopStmt& stmt) override;
+
+protected:
+    std::optional<uint8_t> get_cell(long offset) const;
+
+    void set_cell(long offset, std::optional<uint8_t> value);
+
+    void add_to_cell(const Stmt& stmt, uint8_t delta);
+
+    // the head's position is lost, along with the values of all cells
+    void forget_all();
+
+    const PartialEvaluation* evaluation_ = nullptr;
+
+    HeadMoveAnalyzer head_move_analyzer_;
+
+    // abstract tape, offsets are from an origin that is reset whenever the head's position is lost
+    long offset_ = 0;
+    std::map<long, std::optional<uint8_t>> cells_; // std::nullopt for a cell of unknown value
+    bool rest_zero_ = true; // whether cells missing from cells_ are zero, or unknown
+
+    std::unordered_set<const LoopStmt*> dead_loops_;
+    std::unordered_map<const Stmt*, uint8_t> known_results_;
+    std::unordered_set<const Stmt*> superseded_;
+
+    // the previous statement visited, if it was a +/- of known result
+    const Stmt* last_known_stmt_ = nullptr;
+    std::unordered_map<const LoopStmt*, std::set<long>> written_offsets_;
+};
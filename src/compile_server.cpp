@@ -0,0 +1,420 @@
+#include "compile_server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "compiler.hpp"
+
+namespace {
+
+// starts every request and response, so that a server and client from different builds of bfc
+// never misread each other, bump the version whenever the layout of either changes
+constexpr uint32_t PROTOCOL_MAGIC = 0x21434642; // "BFC!" in little endian
+constexpr uint32_t PROTOCOL_VERSION = 2;
+
+enum class Status : uint32_t {
+    OK = 0,
+    ERROR = 1,
+    UNSUPPORTED_PROTOCOL = 2
+};
+
+bool write_all(int fd, const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::send(fd, ptr, size, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, size_t size) {
+    char* ptr = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t read = ::recv(fd, ptr, size, 0);
+        if (read <= 0) {
+            return false;
+        }
+        ptr += read;
+        size -= read;
+    }
+    return true;
+}
+
+void append_u32(std::string& buffer, uint32_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_u64(std::string& buffer, uint64_t value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_string(std::string& buffer, std::string_view value) {
+    append_u32(buffer, static_cast<uint32_t>(value.size()));
+    buffer.append(value);
+}
+
+void append_header(std::string& buffer) {
+    append_u32(buffer, PROTOCOL_MAGIC);
+    append_u32(buffer, PROTOCOL_VERSION);
+}
+
+// also used as the cache key, since it covers everything that affects the output
+std::string serialize_request(std::string_view source, const Compiler::Options& options) {
+    std::string request;
+    append_u32(request, static_cast<uint32_t>(options.output_type));
+    append_string(request, options.target_triple);
+    append_string(request, options.cpu);
+    append_string(request, options.features);
+    append_u32(request, options.checked);
+    append_u64(request, options.evaluation_budget);
+    append_u64(request, options.chunk_size);
+    append_u32(request, options.codegen_threads);
+    append_string(request, source);
+    return request;
+}
+
+bool read_u32(int fd, uint32_t& value) {
+    return read_all(fd, &value, sizeof(value));
+}
+
+bool read_u64(int fd, uint64_t& value) {
+    return read_all(fd, &value, sizeof(value));
+}
+
+bool read_string(int fd, std::string& value) {
+    uint32_t size;
+    if (!read_u32(fd, size)) {
+        return false;
+    }
+
+    value.resize(size);
+    return read_all(fd, value.data(), size);
+}
+
+// false if the connection closed, or the other end speaks another protocol
+bool read_header(int fd) {
+    uint32_t magic;
+    uint32_t version;
+    return read_u32(fd, magic)
+        && read_u32(fd, version)
+        && magic == PROTOCOL_MAGIC
+        && version == PROTOCOL_VERSION;
+}
+
+bool write_response(int fd, Status status, std::string_view payload) {
+    std::string response;
+    append_header(response);
+    append_u32(response, static_cast<uint32_t>(status));
+    append_string(response, payload);
+    return write_all(fd, response.data(), response.size());
+}
+
+sockaddr_un make_address(const std::string& socket_path) {
+    if (socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+        throw std::runtime_error("Socket path \"" + socket_path + "\" is too long");
+    }
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+// returns -1 if nothing is listening on the socket
+int connect_to(const std::string& socket_path) {
+    sockaddr_un address = make_address(socket_path);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// whether the process on the other end of a connected socket runs as this user,
+// so that no other user can serve or request compilations through the socket
+bool is_own_peer(int fd) {
+    ucred cred {};
+    socklen_t size = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == ::getuid();
+}
+
+// creates the socket's directory if missing, which only this user may access,
+// and refuses a directory in which another user could replace the socket
+bool prepare_socket_dir(const std::string& socket_path, std::string& err) {
+    size_t slash = socket_path.find_last_of('/');
+    if (slash == std::string::npos) {
+        return true;
+    }
+    std::string dir = slash == 0 ? "/" : socket_path.substr(0, slash);
+
+    if (::mkdir(dir.c_str(), S_IRWXU) < 0 && errno != EEXIST) {
+        err = "Failed to create \"" + dir + "\": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat dir_stat;
+    if (::lstat(dir.c_str(), &dir_stat) < 0) {
+        err = "Failed to stat \"" + dir + "\": " + std::strerror(errno);
+        return false;
+    }
+
+    // e.g. /tmp is writable by anyone, but sticky, so only we can remove our socket from it
+    bool owned = dir_stat.st_uid == ::getuid() || dir_stat.st_uid == 0;
+    bool shared_writable = (dir_stat.st_mode & (S_IWGRP | S_IWOTH)) && !(dir_stat.st_mode & S_ISVTX);
+    if (!S_ISDIR(dir_stat.st_mode) || !owned || shared_writable) {
+        err = "\"" + dir + "\" is not a directory private to this user";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+std::string default_server_socket_path() {
+    if (const char* socket_path = std::getenv("BFC_SERVER_SOCKET")) {
+        return socket_path;
+    }
+
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) {
+        return std::string(runtime_dir) + "/bfc.sock";
+    }
+
+    return "/tmp/bfc-" + std::to_string(::getuid()) + "/server.sock";
+}
+
+int CompileServer::run(size_t worker_count) {
+    sockaddr_un address = make_address(socket_path_);
+
+    std::string dir_err;
+    if (!prepare_socket_dir(socket_path_, dir_err)) {
+        std::cerr << dir_err << '\n';
+        return 1;
+    }
+
+    // refuse to steal the socket of a running server, but clean up a stale one
+    int running_fd = connect_to(socket_path_);
+    if (running_fd >= 0) {
+        bool own = is_own_peer(running_fd);
+        ::close(running_fd);
+        std::cerr << (own ? "A server is already listening on \"" : "Another user is listening on \"") << socket_path_ << "\"\n";
+        return 1;
+    }
+    ::unlink(socket_path_.c_str());
+
+    int server_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        std::cerr << "Failed to create socket: " << std::strerror(errno) << '\n';
+        return 1;
+    }
+
+    if (::bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::chmod(socket_path_.c_str(), S_IRUSR | S_IWUSR) < 0
+        || ::listen(server_fd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on \"" << socket_path_ << "\": " << std::strerror(errno) << '\n';
+        ::close(server_fd);
+        return 1;
+    }
+
+    // accepted connections waiting for a worker
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    std::deque<int> queue;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::max<size_t>(worker_count, 1); ++i) {
+        workers.emplace_back([&] {
+            // each worker keeps its own compiler, and so its own warm target machines
+            Compiler compiler;
+
+            while (true) {
+                int client_fd;
+                {
+                    std::unique_lock<std::mutex> lock {queue_mutex};
+                    queue_cond.wait(lock, [&] { return !queue.empty(); });
+                    client_fd = queue.front();
+                    queue.pop_front();
+                }
+
+                serve_client(compiler, client_fd);
+                ::close(client_fd);
+            }
+        });
+    }
+
+    while (true) {
+        int client_fd = ::accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            continue;
+        }
+
+        if (!is_own_peer(client_fd)) {
+            ::close(client_fd);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock {queue_mutex};
+            queue.push_back(client_fd);
+        }
+        queue_cond.notify_one();
+    }
+}
+
+void CompileServer::serve_client(Compiler& compiler, int client_fd) {
+    if (!read_header(client_fd)) {
+        write_response(client_fd, Status::UNSUPPORTED_PROTOCOL, "Unsupported protocol version");
+        return;
+    }
+
+    uint32_t output_type;
+    uint32_t checked;
+    uint64_t evaluation_budget;
+    uint64_t chunk_size;
+    uint32_t codegen_threads;
+    Compiler::Options options;
+    std::string source;
+
+    if (!read_u32(client_fd, output_type)
+        || !read_string(client_fd, options.target_triple)
+        || !read_string(client_fd, options.cpu)
+        || !read_string(client_fd, options.features)
+        || !read_u32(client_fd, checked)
+        || !read_u64(client_fd, evaluation_budget)
+        || !read_u64(client_fd, chunk_size)
+        || !read_u32(client_fd, codegen_threads)
+        || !read_string(client_fd, source)) {
+        return;
+    }
+    options.checked = checked != 0;
+    options.evaluation_budget = evaluation_budget;
+    options.chunk_size = chunk_size;
+
+    // each codegen thread costs a thread, a buffer and a temporary file, so never more than there are cores
+    unsigned max_codegen_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    options.codegen_threads = std::clamp<uint32_t>(codegen_threads, 1, max_codegen_threads);
+
+    if (output_type > static_cast<uint32_t>(Compiler::OutputType::OBJECT)) {
+        write_response(client_fd, Status::ERROR, "Unknown output type");
+        return;
+    }
+    options.output_type = static_cast<Compiler::OutputType>(output_type);
+
+    std::string request = serialize_request(source, options);
+
+    if (std::optional<std::string> output = cache_lookup(request)) {
+        write_response(client_fd, Status::OK, *output);
+        return;
+    }
+
+    std::string output;
+    try {
+        output = compiler.compile(source, options);
+    } catch (const std::exception& err) {
+        write_response(client_fd, Status::ERROR, err.what());
+        return;
+    }
+
+    cache_insert(request, output);
+    write_response(client_fd, Status::OK, output);
+}
+
+std::optional<std::string> CompileServer::cache_lookup(const std::string& request) {
+    std::lock_guard<std::mutex> lock {cache_mutex_};
+
+    auto it = cache_index_.find(request);
+    if (it == cache_index_.end()) {
+        return std::nullopt;
+    }
+
+    // mark as most recently used
+    cache_entries_.splice(cache_entries_.begin(), cache_entries_, it->second);
+    return it->second->second;
+}
+
+void CompileServer::cache_insert(const std::string& request, const std::string& output) {
+    std::lock_guard<std::mutex> lock {cache_mutex_};
+
+    size_t entry_size = request.size() + output.size();
+    if (entry_size > cache_capacity_ || cache_index_.count(request)) {
+        return;
+    }
+
+    cache_entries_.emplace_front(request, output);
+    cache_index_.emplace(cache_entries_.front().first, cache_entries_.begin());
+    cache_size_ += entry_size;
+
+    // evict the least recently used entries until everything fits
+    while (cache_size_ > cache_capacity_) {
+        const auto& [evicted_request, evicted_output] = cache_entries_.back();
+        cache_size_ -= evicted_request.size() + evicted_output.size();
+        cache_index_.erase(evicted_request);
+        cache_entries_.pop_back();
+    }
+}
+
+std::optional<std::string> CompileClient::compile(std::string_view source, const Compiler::Options& options) {
+    int fd = connect_to(socket_path_);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    // never trust output served by another user, compile locally instead
+    if (!is_own_peer(fd)) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    std::string request;
+    append_header(request);
+    request += serialize_request(source, options);
+
+    uint32_t status;
+    std::string payload;
+    bool ok = write_all(fd, request.data(), request.size())
+        && read_header(fd)
+        && read_u32(fd, status)
+        && read_string(fd, payload);
+    ::close(fd);
+
+    // the server went away, or is from another build of bfc, fall back to compiling locally
+    if (!ok || static_cast<Status>(status) == Status::UNSUPPORTED_PROTOCOL) {
+        return std::nullopt;
+    }
+
+    if (static_cast<Status>(status) != Status::OK) {
+        throw std::runtime_error(payload);
+    }
+
+    return payload;
+}
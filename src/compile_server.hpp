@@ -0,0 +1,71 @@
+/*
+Compile server, which keeps LLVM initialized and its target machines warm between invocations.
+
+The server listens on a Unix domain socket, and serves each connection a single compile request.
+Both ends check that the other runs as the same user, so output is never taken from, or served to,
+anyone else. Requests are handled concurrently by a fixed pool of workers, each with its own
+Compiler (and so its own LLVM contexts and target machines), and results are shared between workers through an
+in-memory LRU cache keyed on the full request, and bounded by the total size of its requests and outputs.
+
+Wire format, integers are u32 (u64 for sizes) in host byte order, strings are a u32 length followed by the bytes:
+    request:  magic, version, output_type, target_triple, cpu, features, checked, evaluation_budget (u64),
+              chunk_size (u64), codegen_threads, source
+    response: magic, version, status (0 on success), output or error message
+
+A server and client only talk if both magic and version match, otherwise the client compiles locally.
+*/
+#pragma once
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "compiler.hpp"
+
+// $BFC_SERVER_SOCKET if set, otherwise bfc.sock in $XDG_RUNTIME_DIR, otherwise a socket in a per-user directory in /tmp
+std::string default_server_socket_path();
+
+class CompileServer {
+public:
+    // in bytes of requests and outputs
+    static constexpr size_t DEFAULT_CACHE_CAPACITY = 256 * 1024 * 1024;
+
+    explicit CompileServer(std::string socket_path, size_t cache_capacity = DEFAULT_CACHE_CAPACITY) :
+        socket_path_{std::move(socket_path)},
+        cache_capacity_{cache_capacity} {}
+
+    // blocks serving requests, only returns (non-zero) if the socket cannot be set up
+    int run(size_t worker_count);
+
+protected:
+    void serve_client(Compiler& compiler, int client_fd);
+
+    std::optional<std::string> cache_lookup(const std::string& request);
+
+    void cache_insert(const std::string& request, const std::string& output);
+
+    std::string socket_path_;
+
+    // most recently used entries first
+    size_t cache_capacity_;
+    size_t cache_size_ = 0;
+    std::mutex cache_mutex_;
+    std::list<std::pair<std::string, std::string>> cache_entries_;
+    std::unordered_map<std::string_view, std::list<std::pair<std::string, std::string>>::iterator> cache_index_;
+};
+
+class CompileClient {
+public:
+    explicit CompileClient(std::string socket_path) : socket_path_{std::move(socket_path)} {}
+
+    // returns std::nullopt if no server is listening
+    // throws std::runtime_error if the server fails to compile the source
+    std::optional<std::string> compile(std::string_view source, const Compiler::Options& options);
+
+protected:
+    std::string socket_path_;
+};
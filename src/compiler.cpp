@@ -0,0 +1,236 @@
+#include "compiler.hpp"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/TargetParser/Triple.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/TargetSelect.h> // for initialization functions
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
+
+#include "parser.hpp"
+#include "ast.hpp"
+#include "generator.hpp"
+#include "partial_evaluator.hpp"
+#include "cell_value_analyzer.hpp"
+#include "ostream_to_llvm_raw_pwrite_stream_adaptor.hpp"
+#include "output.hpp"
+
+#include <lld/Common/Driver.h>
+
+LLD_HAS_DRIVER(elf)
+
+std::string Compiler::compile(std::string_view source, const Options& options) {
+
+    // parse input code
+    std::istringstream input {std::string(source)};
+    Parser parser (input);
+    std::unique_ptr<Program> program = parser.parse();
+
+    // run what can be run at compile time
+    PartialEvaluator evaluator (Generator::STACK_SIZE, options.evaluation_budget);
+    if (options.evaluation_budget > 0) {
+        program->accept(evaluator);
+    }
+
+    // find cells with values known at compile time
+    CellValueAnalyzer cell_values;
+    if (options.evaluation_budget > 0) {
+        cell_values.set_partial_evaluation(&evaluator.get_evaluation());
+    }
+    program->accept(cell_values);
+
+    // generate llvm module
+    Generator generator (options.chunk_size, options.checked);
+    if (options.evaluation_budget > 0) {
+        generator.set_partial_evaluation(&evaluator.get_evaluation());
+    }
+    generator.set_cell_values(&cell_values);
+    program->accept(generator);
+    llvm::Module& module_ = generator.get_module();
+
+    // verify module
+    std::string verify_err;
+    llvm::raw_string_ostream verify_err_stream {verify_err};
+    if (llvm::verifyModule(module_, &verify_err_stream)) {
+        throw std::runtime_error("Generated module has errors: " + verify_err_stream.str());
+    }
+
+    // generate final output
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream output {buffer};
+
+    switch (options.output_type) {
+    case OutputType::LLVM_IR:
+        module_.print(output, nullptr); // write LLVM IR
+        break;
+    case OutputType::LLVM_BITCODE:
+        llvm::WriteBitcodeToFile(module_, output); // llvm bitcode format obj files
+        break;
+    case OutputType::ASSEMBLY:
+    case OutputType::OBJECT: {
+        LLVMModuleEmitter emitter(module_, get_target_machine(options));
+
+        // partitions can only be linked back together for ELF objects
+        if (options.output_type == OutputType::OBJECT
+            && options.codegen_threads > 1
+            && llvm::Triple(module_.getTargetTriple()).isOSBinFormatELF()) {
+            return emit_parallel(module_, options);
+        }
+
+        llvm::CodeGenFileType file_type = options.output_type == OutputType::ASSEMBLY
+            ? llvm::CodeGenFileType::CGFT_AssemblyFile
+            : llvm::CodeGenFileType::CGFT_ObjectFile;
+
+        if (emitter.emit(output, file_type)) {
+            throw std::runtime_error("Failed to emit module");
+        }
+        break;
+    }
+    }
+
+    return std::string(buffer.begin(), buffer.end());
+}
+
+std::string Compiler::emit_parallel(llvm::Module& module_, const Options& options) {
+    std::string target_triple = module_.getTargetTriple();
+
+    // each partition is emitted in its own context, by its own target machine
+    std::vector<llvm::SmallVector<char, 0>> part_buffers (options.codegen_threads);
+    std::vector<std::unique_ptr<llvm::raw_svector_ostream>> part_streams;
+    std::vector<llvm::raw_pwrite_stream*> part_stream_ptrs;
+    for (llvm::SmallVector<char, 0>& part_buffer : part_buffers) {
+        part_streams.push_back(std::make_unique<llvm::raw_svector_ostream>(part_buffer));
+        part_stream_ptrs.push_back(part_streams.back().get());
+    }
+
+    // splitting makes internal symbols global, so that partitions can reference each other, 
+    // keeping them local would force every chunk into main's partition, see the generator's symbol_name
+    llvm::splitCodeGen(
+        module_,
+        part_stream_ptrs,
+        {},
+        [&] {
+            std::string err;
+            return LLVMModuleEmitter::create_target_machine(target_triple, options.cpu, options.features, err);
+        },
+        llvm::CodeGenFileType::CGFT_ObjectFile
+    );
+
+    // lld links from files on disk
+    std::vector<std::string> part_paths;
+    std::deque<llvm::FileRemover> part_removers; // never relocates, so never deletes early
+
+    for (const llvm::SmallVector<char, 0>& part_buffer : part_buffers) {
+        int fd;
+        llvm::SmallString<128> part_path;
+        if (llvm::sys::fs::createTemporaryFile("bfc-part", "o", fd, part_path)) {
+            throw std::runtime_error("Failed to create a temporary object file");
+        }
+        part_removers.emplace_back(part_path);
+
+        llvm::raw_fd_ostream part_file {fd, true};
+        part_file.write(part_buffer.data(), part_buffer.size());
+        part_file.close();
+
+        part_paths.push_back(part_path.str().str());
+    }
+
+    llvm::SmallString<128> linked_path;
+    if (llvm::sys::fs::createTemporaryFile("bfc", "o", linked_path)) {
+        throw std::runtime_error("Failed to create a temporary object file");
+    }
+    part_removers.emplace_back(linked_path);
+
+    std::vector<const char*> lld_args {"ld.lld", "-r", "-o", linked_path.c_str()};
+    for (const std::string& part_path : part_paths) {
+        lld_args.push_back(part_path.c_str());
+    }
+
+    std::string lld_err;
+    llvm::raw_string_ostream lld_err_stream {lld_err};
+    {
+        // lld keeps global state, so only one link can run at a time
+        static std::mutex lld_mutex;
+        std::lock_guard<std::mutex> lock {lld_mutex};
+
+        lld::Result result = lld::lldMain(lld_args, llvm::nulls(), lld_err_stream, {{lld::Gnu, &lld::elf::link}});
+        if (result.retCode != 0) {
+            throw std::runtime_error("Failed to link object partitions: " + lld_err_stream.str());
+        }
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> linked = llvm::MemoryBuffer::getFile(linked_path);
+    if (!linked) {
+        throw std::runtime_error("Failed to read linked object file: " + linked.getError().message());
+    }
+
+    return (*linked)->getBuffer().str();
+}
+
+void Compiler::initialize_target(const std::string& target_triple) {
+    static std::once_flag native_flag;
+    static std::once_flag all_flag;
+
+    llvm::Triple triple {target_triple};
+    llvm::Triple host_triple {llvm::sys::getProcessTriple()};
+
+    if (triple.getArch() == host_triple.getArch()) {
+        std::call_once(native_flag, [] {
+            llvm::InitializeNativeTarget();
+            llvm::InitializeNativeTargetAsmPrinter();
+        });
+    } else {
+        std::call_once(all_flag, [] {
+            llvm::InitializeAllTargetInfos();
+            llvm::InitializeAllTargets();
+            llvm::InitializeAllTargetMCs();
+            llvm::InitializeAllAsmPrinters();
+        });
+    }
+}
+
+llvm::TargetMachine& Compiler::get_target_machine(const Options& options) {
+    std::string target_triple = options.target_triple.empty()
+        ? llvm::sys::getDefaultTargetTriple()
+        : options.target_triple;
+
+    TargetMachineKey key {target_triple, options.cpu, options.features};
+
+    auto it = target_machines_.find(key);
+    if (it != target_machines_.end()) {
+        return *it->second;
+    }
+
+    initialize_target(target_triple);
+
+    std::string err;
+    std::unique_ptr<llvm::TargetMachine> target_machine = LLVMModuleEmitter::create_target_machine(
+        target_triple,
+        options.cpu,
+        options.features,
+        err
+    );
+
+    if (!target_machine) {
+        throw std::runtime_error(err);
+    }
+
+    return *target_machines_.emplace(key, std::move(target_machine)).first->second;
+}
@@ -0,0 +1,70 @@
+/*
+Library entry point for embedding the compiler, e.g. in a long running service.
+
+LLVM target initialization happens once per process, and target machines are cached per
+target triple/cpu/features, so that repeated compilations only pay for parsing, generation and
+code emission.
+
+A Compiler is not thread safe, use one Compiler per thread.
+*/
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "generator.hpp"
+#include "partial_evaluator.hpp"
+
+class Compiler {
+public:
+    enum class OutputType {
+        LLVM_IR, // textual LLVM IR (.ll)
+        LLVM_BITCODE, // LLVM bitcode (.bc)
+        ASSEMBLY, // target assembly (.s)
+        OBJECT // target object file (.o)
+    };
+
+    struct Options {
+        OutputType output_type = OutputType::OBJECT;
+
+        std::string target_triple = ""; // empty selects the host triple
+        std::string cpu = "generic"; // "native" selects the host cpu and its features
+        std::string features = "";
+
+        // trap with a diagnostic rather than moving the head off the tape
+        bool checked = false;
+
+        // steps to run the input free prefix of the program for at compile time, 0 disables it
+        size_t evaluation_budget = PartialEvaluator::DEFAULT_STEP_BUDGET;
+
+        // statements per generated function, 0 keeps the whole program in main
+        size_t chunk_size = Generator::DEFAULT_CHUNK_SIZE;
+
+        // threads to split object code generation over, for ELF targets
+        unsigned codegen_threads = 1;
+    };
+
+    // throws std::runtime_error if the source fails to parse or cannot be emitted
+    std::string compile(std::string_view source, const Options& options);
+
+    // initializes only the native target, unless a foreign target is requested
+    static void initialize_target(const std::string& target_triple);
+
+protected:
+
+    llvm::TargetMachine& get_target_machine(const Options& options);
+
+    // generates object code for partitions of the module on several threads, 
+    // then links the partitions back into a single relocatable object
+    std::string emit_parallel(llvm::Module& module_, const Options& options);
+
+    // target triple, cpu, features
+    using TargetMachineKey = std::tuple<std::string, std::string, std::string>;
+
+    std::map<TargetMachineKey, std::unique_ptr<llvm::TargetMachine>> target_machines_;
+};
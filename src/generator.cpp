@@ -1,20 +1,38 @@
 #include "generator.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Intrinsics.h>
 #include "ast.hpp"
 
-Generator::Generator() : 
+namespace {
+
+// names a module level symbol besides main, these stay local to a single object file, but become
+// (hidden) globals when the module is split for parallel codegen, so must not collide with user code
+std::string symbol_name(std::string_view name) {
+    return "__bfc_" + std::string(name);
+}
+
+} // namespace
+
+Generator::Generator(size_t chunk_size, bool checked) : 
         context_{},
         module_{std::make_unique<llvm::Module>("bf_module", context_)}, 
-        builder_{context_}
+        builder_{context_},
+        checked_{checked},
+        chunk_size_{chunk_size}
 {
     I1_T_ = llvm::Type::getInt1Ty(context_);
     I8_T_ = llvm::Type::getInt8Ty(context_);
@@ -39,6 +57,43 @@ Generator::Generator() :
 
     // define the memset func, needed for clearing stack
     memset_func_callee_ = module_->getOrInsertFunction("memset", llvm::FunctionType::get(I8_T_, {I8_T_->getPointerTo(), I8_T_, I64_T_, I1_T_}, false));
+
+    // define the getchar function used for read
+    getchar_func_callee_ = module_->getOrInsertFunction("getchar", llvm::FunctionType::get(I32_T_, false));
+
+    // define the write function, used for output known at compile time
+    write_func_callee_ = module_->getOrInsertFunction("write", llvm::FunctionType::get(I64_T_, {I32_T_, I8_T_->getPointerTo(), I64_T_}, false));
+
+    if (checked_) {
+
+        // define the function called when the head leaves the tape, which reports it and traps
+        bounds_fail_func_ = llvm::Function::Create(
+            llvm::FunctionType::get(llvm::Type::getVoidTy(context_), false),
+            llvm::Function::InternalLinkage, symbol_name("boundsFail"), module_.get()
+        );
+        bounds_fail_func_->addFnAttr(llvm::Attribute::NoReturn);
+        bounds_fail_func_->addFnAttr(llvm::Attribute::Cold);
+        bounds_fail_func_->addFnAttr(llvm::Attribute::NoInline);
+
+        builder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "entry", bounds_fail_func_));
+
+        // flush what has been printed so far, before trapping
+        llvm::FunctionCallee fflush_func_callee = module_->getOrInsertFunction("fflush", llvm::FunctionType::get(I32_T_, {I8_T_->getPointerTo()}, false));
+        builder_.CreateCall(fflush_func_callee, {llvm::ConstantPointerNull::get(I8_T_->getPointerTo())});
+
+        std::string message = "bfc: tape head moved out of bounds\n";
+        llvm::Value* stderr_fd_i32 = llvm::ConstantInt::get(I32_T_, 2);
+        llvm::Value* message_size_i64 = llvm::ConstantInt::get(I64_T_, message.size());
+        builder_.CreateCall(write_func_callee_, {stderr_fd_i32, builder_.CreateGlobalStringPtr(message, symbol_name("boundsFailMessage")), message_size_i64});
+        builder_.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+        builder_.CreateUnreachable();
+
+        // the start of the tape, for functions besides main
+        tape_global_ = new llvm::GlobalVariable(
+            *module_, I8_T_->getPointerTo(), false, llvm::GlobalValue::InternalLinkage, 
+            llvm::ConstantPointerNull::get(I8_T_->getPointerTo()), symbol_name("tape")
+        );
+    }
 }
 
 
@@ -46,26 +101,134 @@ llvm::Module& Generator::get_module() {
     return *module_;
 }
 
+void Generator::set_partial_evaluation(const PartialEvaluation* evaluation) {
+    evaluation_ = evaluation;
+}
+
+void Generator::set_cell_values(const CellValueAnalyzer* cell_values) {
+    cell_values_ = cell_values;
+}
+
 void Generator::visit(const Program* prog) {
 
     builder_.SetInsertPoint(entry_);
 
+    // without an evaluation, the whole program is left to run
+    const StmtList* stmt_list = prog->stmt_list.get();
+
+    if (evaluation_) {
+        stmt_list = evaluation_->residual;
+
+        // write the output of the evaluated prefix in one go
+        if (!evaluation_->output.empty()) {
+            llvm::Constant* output = builder_.CreateGlobalStringPtr(evaluation_->output, symbol_name("evaluatedOutput"));
+            llvm::Value* stdout_fd_i32 = llvm::ConstantInt::get(I32_T_, 1);
+            llvm::Value* output_size_i64 = llvm::ConstantInt::get(I64_T_, evaluation_->output.size());
+            builder_.CreateCall(write_func_callee_, {stdout_fd_i32, output, output_size_i64});
+        }
+
+        // nothing left to run
+        if (!stmt_list) {
+            builder_.CreateRet(llvm::ConstantInt::get(I32_T_, 0));
+            return;
+        }
+    }
+
     llvm::Value* stack_size_i64 = llvm::ConstantInt::get(I64_T_, STACK_SIZE);
 
     // set the head pointer
     head_ = builder_.CreateAlloca(I8_T_, stack_size_i64, "stack");
-
-    // memset the stack to all zeroes
-    llvm::Value* is_volatile_i1 = llvm::ConstantInt::get(I1_T_, false); // 0 for non-volatile
-    builder_.CreateCall(memset_func_callee_, {head_, I8_V_0_, stack_size_i64, is_volatile_i1 });
+    llvm::Value* stack = head_;
+
+    if (evaluation_ && std::any_of(evaluation_->tape.begin(), evaluation_->tape.end(), [](uint8_t cell) { return cell != 0; })) {
+
+        // copy in the tape left by the evaluated prefix
+        llvm::Constant* tape_init = llvm::ConstantDataArray::get(context_, llvm::ArrayRef<uint8_t>(evaluation_->tape));
+        llvm::GlobalVariable* tape_init_global = new llvm::GlobalVariable(
+            *module_, tape_init->getType(), true, llvm::GlobalValue::PrivateLinkage, tape_init, symbol_name("evaluatedTape")
+        );
+        builder_.CreateMemCpy(stack, llvm::MaybeAlign(1), tape_init_global, llvm::MaybeAlign(1), stack_size_i64);
+    } else {
+
+        // memset the stack to all zeroes
+        llvm::Value* is_volatile_i1 = llvm::ConstantInt::get(I1_T_, false); // 0 for non-volatile
+        builder_.CreateCall(memset_func_callee_, {stack, I8_V_0_, stack_size_i64, is_volatile_i1 });
+    }
+
+    if (evaluation_ && evaluation_->head != 0) {
+        head_ = builder_.CreateGEP(I8_T_, stack, llvm::ConstantInt::get(I64_T_, evaluation_->head), "evaluatedHead");
+    }
+
+    if (checked_) {
+        builder_.CreateStore(stack, tape_global_);
+        needs_bounds_check_ = true;
+    }
     
     // generate program stmt_list code
-    prog->stmt_list->accept(*this);
+    chunk_next_stmt_list_ = chunk_size_ > 0 && stmt_list->size() > chunk_size_;
+    stmt_list->accept(*this);
 
     //builder_.CreateRet(builder_.getInt32(0));
     builder_.CreateRet(llvm::ConstantInt::get(I32_T_, 0));
 }
 
+void Generator::visit(const FullStmtList& stmt_list) {
+    bool chunked = chunk_next_stmt_list_;
+    chunk_next_stmt_list_ = false;
+
+    if (!chunked) {
+        for (const FullStmtList* it = &stmt_list; it; it = it->next_full()) {
+            if (needs_bounds_check_) {
+                emit_bounds_check(head_move_analyzer_.segment_extent(it));
+                needs_bounds_check_ = false;
+            }
+
+            it->stmt->accept(*this);
+        }
+        return;
+    }
+
+    // emit consecutive statements into chunk functions of at most chunk_size_ statements, 
+    // which the current function calls in sequence, passing the head pointer along
+    llvm::IRBuilderBase::InsertPoint caller_ip;
+    llvm::Value* caller_head = head_;
+    size_t chunk_stmts = 0;
+    bool in_chunk = false;
+
+    for (const FullStmtList* it = &stmt_list; it; it = it->next_full()) {
+        size_t stmt_size = it->stmt->size();
+
+        if (!in_chunk || chunk_stmts + stmt_size > chunk_size_) {
+            if (in_chunk) {
+                builder_.CreateRet(head_);
+                builder_.restoreIP(caller_ip);
+            }
+
+            llvm::Function* chunk_func = create_chunk_func(symbol_name("chunk"));
+            caller_head = builder_.CreateCall(chunk_func, {caller_head}, "chunkHead");
+            caller_ip = builder_.saveIP();
+
+            builder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "entry", chunk_func));
+            head_ = chunk_func->getArg(0);
+            chunk_stmts = 0;
+            in_chunk = true;
+        }
+
+        if (needs_bounds_check_) {
+            emit_bounds_check(head_move_analyzer_.segment_extent(it));
+            needs_bounds_check_ = false;
+        }
+
+        // a statement larger than a chunk is a loop, whose body will be chunked in turn
+        it->stmt->accept(*this);
+        chunk_stmts += stmt_size;
+    }
+
+    builder_.CreateRet(head_);
+    builder_.restoreIP(caller_ip);
+    head_ = caller_head;
+}
+
 void Generator::visit(const LeftStmt& stmt) {
     head_ = builder_.CreateGEP(I8_T_, head_, I8_V_N1_, "left");
 }
@@ -75,17 +238,45 @@ void Generator::visit(const RightStmt& stmt) {
 }
 
 void Generator::visit(const IncStmt& stmt) {
+    if (cell_values_ && cell_values_->is_superseded(stmt)) {
+        return;
+    }
+
+    if (std::optional<uint8_t> known = cell_values_ ? cell_values_->known_result(stmt) : std::nullopt) {
+        builder_.CreateStore(llvm::ConstantInt::get(I8_T_, *known), head_);
+        return;
+    }
+
     llvm::Value* inc_load = builder_.CreateLoad(I8_T_, head_, "incLoadTmp");
     llvm::Value* inc = builder_.CreateAdd(inc_load, I8_V_1_, "inc");
     builder_.CreateStore(inc, head_);
 }
 
 void Generator::visit(const DecStmt& stmt) {
+    if (cell_values_ && cell_values_->is_superseded(stmt)) {
+        return;
+    }
+
+    if (std::optional<uint8_t> known = cell_values_ ? cell_values_->known_result(stmt) : std::nullopt) {
+        builder_.CreateStore(llvm::ConstantInt::get(I8_T_, *known), head_);
+        return;
+    }
+
     llvm::Value* dec_load = builder_.CreateLoad(I8_T_, head_, "decLoadTmp");
     llvm::Value* dec = builder_.CreateAdd(dec_load, I8_V_N1_, "dec");
     builder_.CreateStore(dec, head_);
 }
 
+void Generator::visit(const ReadStmt& stmt) {
+    llvm::Value* input = builder_.CreateCall(getchar_func_callee_, {}, "readInput");
+
+    // the end of input reads as 0
+    llvm::Value* is_eof = builder_.CreateICmpSLT(input, llvm::ConstantInt::get(I32_T_, 0), "readIsEof");
+    llvm::Value* input_val = builder_.CreateTrunc(input, I8_T_, "readTruncTmp");
+    llvm::Value* val = builder_.CreateSelect(is_eof, I8_V_0_, input_val, "read");
+    builder_.CreateStore(val, head_);
+}
+
 void Generator::visit(const PrintStmt& stmt) {
     llvm::Value* val = builder_.CreateLoad(I8_T_, head_, "printLoadTmp");
     
@@ -96,34 +287,100 @@ void Generator::visit(const PrintStmt& stmt) {
 }
 
 void Generator::visit(const LoopStmt& stmt) {
-    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context_, "loop", main_func_);
-    llvm::BasicBlock* done = llvm::BasicBlock::Create(context_, "done", main_func_);
+    const FullStmtList* body = dynamic_cast<const FullStmtList*>(stmt.stmt_list.get());
+    bool balanced = head_move_analyzer_.is_balanced(stmt);
+
+    // segments still end at a removed loop, so the next one needs its own check
+    if (cell_values_ && cell_values_->is_dead(stmt)) {
+        needs_bounds_check_ = checked_ && !balanced;
+        return;
+    }
+
+    // every iteration of a balanced loop starts from the same head, 
+    // so a single check on entering the loop covers all of them
+    if (checked_ && balanced) {
+        llvm::Value* entry_load = builder_.CreateLoad(I8_T_, head_, "headLoadLoopEntryTmp");
+        llvm::Value* is_entered = builder_.CreateICmpNE(entry_load, I8_V_0_, "loopEntered");
+        emit_bounds_check(head_move_analyzer_.segment_extent(body), is_entered);
+    }
+
+    llvm::Function* func = builder_.GetInsertBlock()->getParent();
+    llvm::BasicBlock* pre = builder_.GetInsertBlock();
+    llvm::BasicBlock* cond = llvm::BasicBlock::Create(context_, "loopCond", func);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(context_, "loop", func);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(context_, "done", func);
+
+    // check cond before each iteration, the head may have moved in the previous one
+    builder_.CreateBr(cond);
+    builder_.SetInsertPoint(cond);
+
+    llvm::PHINode* loop_head = builder_.CreatePHI(head_->getType(), 2, "loopHead");
+    loop_head->addIncoming(head_, pre);
+
+    llvm::Value* head_load = builder_.CreateLoad(I8_T_, loop_head, "headLoadLoopCondCheckTmp");
+    llvm::Value* is_zero = builder_.CreateICmpEQ(head_load, I8_V_0_, "loopCond");
+    builder_.CreateCondBr(is_zero, done, loop);
 
-    // start loop
-    builder_.CreateBr(loop);
+    // visit stmt list which is loop body code
     builder_.SetInsertPoint(loop);
+    head_ = loop_head;
 
-    // visit stmt list which is loop body code
-    stmt.stmt_list->accept(*this);
+    // otherwise each iteration checks its own segments
+    needs_bounds_check_ = checked_ && !balanced;
 
-    // end of loop, check cond
-    llvm::Value* head_load = builder_.CreateLoad(I8_T_, head_, "headLoadLoopCondCheckTmp");
-    llvm::Value* cond = builder_.CreateICmpEQ(head_load, I8_V_0_, "loopCond");
+    chunk_next_stmt_list_ = chunk_size_ > 0 && stmt.stmt_list->size() > chunk_size_;
+    stmt.stmt_list->accept(*this);
 
-    //builder_.CreateCondBr(cond, loop, done);
-    builder_.CreateCondBr(cond, done, loop);
+    loop_head->addIncoming(head_, builder_.GetInsertBlock());
+    builder_.CreateBr(cond);
 
     builder_.SetInsertPoint(done);
-}
+    head_ = loop_head;
 
+    // the head is on the tape where the loop exits, but not necessarily after moving on from it
+    needs_bounds_check_ = checked_ && !balanced;
+}
 
+void Generator::emit_bounds_check(const HeadExtent& extent, llvm::Value* guard) {
 
+    // the head itself is always on the tape
+    if (extent.min == 0 && extent.max == 0) {
+        return;
+    }
 
+    llvm::Value* tape = builder_.CreateLoad(I8_T_->getPointerTo(), tape_global_, "tape");
+    llvm::Value* offset = builder_.CreatePtrDiff(I8_T_, head_, tape, "headOffset");
 
+    // head + min >= 0 and head + max < STACK_SIZE, as one unsigned comparison
+    long span = extent.max - extent.min;
+    llvm::Value* in_bounds = llvm::ConstantInt::getFalse(context_);
+    if (span < static_cast<long>(STACK_SIZE)) {
+        llvm::Value* min_offset = builder_.CreateAdd(offset, llvm::ConstantInt::get(I64_T_, extent.min), "minOffset");
+        in_bounds = builder_.CreateICmpULT(min_offset, llvm::ConstantInt::get(I64_T_, STACK_SIZE - span), "inBounds");
+    }
 
+    if (guard) {
+        in_bounds = builder_.CreateOr(builder_.CreateNot(guard), in_bounds, "inBoundsOrUnguarded");
+    }
 
+    llvm::Function* func = builder_.GetInsertBlock()->getParent();
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(context_, "boundsOk", func);
+    llvm::BasicBlock* fail = llvm::BasicBlock::Create(context_, "boundsFail", func);
 
+    builder_.CreateCondBr(in_bounds, ok, fail);
 
+    builder_.SetInsertPoint(fail);
+    builder_.CreateCall(bounds_fail_func_);
+    builder_.CreateUnreachable();
 
+    builder_.SetInsertPoint(ok);
+}
 
+llvm::Function* Generator::create_chunk_func(const std::string& name) {
+    llvm::Type* head_t = I8_T_->getPointerTo();
 
+    return llvm::Function::Create(
+        llvm::FunctionType::get(head_t, {head_t}, false),
+        llvm::Function::InternalLinkage, name, module_.get()
+    );
+}
@@ -5,16 +5,27 @@
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Intrinsics.h>
 #include "ast.hpp"
+#include "visitor.hpp"
+#include "partial_evaluator.hpp"
+#include "head_move_analyzer.hpp"
+#include "cell_value_analyzer.hpp"
 
-class Generator {
-protected:
+class Generator : public Visitor {
+public:
     static constexpr size_t STACK_SIZE = 255;
 
+    // statements per generated function, beyond which the program is split into several 
+    // functions, since llvm's backend scales superlinearly with the size of a function
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 4096;
+
+protected:
+
     // unfortunately, these cannot be static, since they depend on context_
     // furthermore they cannot be constant, since llvm doesn't account for
     // ... constant variants, even though they should never be changed
@@ -32,25 +43,43 @@ protected:
     llvm::ConstantInt* I8_V_N1_; // -1
 
 public:
-    Generator();
+    // a chunk_size of 0 keeps the whole program in main
+    // checked traps with a diagnostic rather than accessing memory outside of the tape
+    explicit Generator(size_t chunk_size = DEFAULT_CHUNK_SIZE, bool checked = false);
 
     llvm::Module& get_module();
 
-    void visit(const Program* prog);
+    // start from the state left by evaluating the program's prefix at compile time
+    void set_partial_evaluation(const PartialEvaluation* evaluation);
+
+    // skip loops that never run, and store the results of +/- with known values
+    void set_cell_values(const CellValueAnalyzer* cell_values);
+
+    void visit(const Program* prog) override;
 
-    void visit(const LeftStmt& stmt);
+    void visit(const FullStmtList& stmt_list) override;
 
-    void visit(const RightStmt& stmt);
+    void visit(const LeftStmt& stmt) override;
 
-    void visit(const IncStmt& stmt);
+    void visit(const RightStmt& stmt) override;
 
-    void visit(const DecStmt& stmt);
+    void visit(const IncStmt& stmt) override;
 
-    void visit(const PrintStmt& stmt);
+    void visit(const DecStmt& stmt) override;
 
-    void visit(const LoopStmt& stmt);
+    void visit(const ReadStmt& stmt) override;
+
+    void visit(const PrintStmt& stmt) override;
+
+    void visit(const LoopStmt& stmt) override;
 
 protected:
+    // creates a function taking and returning the head pointer, for a chunk of the program
+    llvm::Function* create_chunk_func(const std::string& name);
+
+    // traps unless the head stays on the tape over extent, or guard is false
+    void emit_bounds_check(const HeadExtent& extent, llvm::Value* guard = nullptr);
+
     llvm::LLVMContext context_;
 
     std::unique_ptr<llvm::Module> module_; // the module to construct
@@ -58,9 +87,24 @@ protected:
     llvm::Function* main_func_;
     llvm::FunctionCallee putchar_func_callee_;
     llvm::FunctionCallee memset_func_callee_;
+    llvm::FunctionCallee getchar_func_callee_;
+    llvm::FunctionCallee write_func_callee_;
+    llvm::Function* bounds_fail_func_ = nullptr;
 
     llvm::BasicBlock* entry_; // entry point aka main
 
     llvm::Value* head_; // pointer to the stack head
     llvm::IRBuilder<> builder_;
+
+    const PartialEvaluation* evaluation_ = nullptr;
+    const CellValueAnalyzer* cell_values_ = nullptr;
+
+    // checked mode
+    bool checked_;
+    bool needs_bounds_check_ = false; // before the next statement, which starts a segment
+    HeadMoveAnalyzer head_move_analyzer_;
+    llvm::GlobalVariable* tape_global_ = nullptr; // start of the tape, for functions besides main
+
+    size_t chunk_size_;
+    bool chunk_next_stmt_list_ = false; // split the next visited stmt list into chunk functions
 };
@@ -0,0 +1,60 @@
+#include "head_move_analyzer.hpp"
+#include <algorithm>
+#include <optional>
+#include "ast.hpp"
+
+std::optional<long> HeadMoveAnalyzer::loop_net_offset(const LoopStmt& stmt) {
+    auto it = loop_net_offsets_.find(&stmt);
+    if (it != loop_net_offsets_.end()) {
+        return it->second;
+    }
+
+    Walk body = walk(dynamic_cast<const FullStmtList*>(stmt.stmt_list.get()));
+
+    std::optional<long> net_offset;
+    if (!body.stopped) {
+        net_offset = body.offset;
+    }
+
+    loop_net_offsets_.emplace(&stmt, net_offset);
+    return net_offset;
+}
+
+bool HeadMoveAnalyzer::is_balanced(const LoopStmt& stmt) {
+    return loop_net_offset(stmt) == 0;
+}
+
+HeadExtent HeadMoveAnalyzer::segment_extent(const FullStmtList* stmt_list) {
+    return walk(stmt_list).extent;
+}
+
+void HeadMoveAnalyzer::visit(const LeftStmt& stmt) {
+    --walk_.offset;
+    walk_.extent.min = std::min(walk_.extent.min, walk_.offset);
+}
+
+void HeadMoveAnalyzer::visit(const RightStmt& stmt) {
+    ++walk_.offset;
+    walk_.extent.max = std::max(walk_.extent.max, walk_.offset);
+}
+
+void HeadMoveAnalyzer::visit(const LoopStmt& stmt) {
+    if (!is_balanced(stmt)) {
+        walk_.stopped = true;
+    }
+}
+
+HeadMoveAnalyzer::Walk HeadMoveAnalyzer::walk(const FullStmtList* stmt_list) {
+
+    // nested loops are walked while walking their parent
+    Walk outer = walk_;
+    walk_ = Walk{};
+
+    for (const FullStmtList* it = stmt_list; it && !walk_.stopped; it = it->next_full()) {
+        it->stmt->accept(*this);
+    }
+
+    Walk result = walk_;
+    walk_ = outer;
+    return result;
+}
@@ -0,0 +1,63 @@
+/*
+Works out how far the head moves over runs of statements, so that bounds checks can cover a whole
+run at once rather than checking every move.
+
+A loop is balanced if each iteration leaves the head where it started, which is only known when
+every loop nested in it is balanced too. A segment is the statements from some point in a list up
+to its end or its first unbalanced loop. Loops within a segment only contribute the offset they
+start at, since they may not run at all.
+*/
+#pragma once
+#include <optional>
+#include <unordered_map>
+#include "ast.hpp"
+#include "visitor.hpp"
+
+// offsets from the head at the start of a segment
+struct HeadExtent {
+    long min = 0;
+    long max = 0;
+};
+
+class HeadMoveAnalyzer : public Visitor {
+public:
+    // net head movement of an iteration, std::nullopt if it depends on how often nested loops run
+    std::optional<long> loop_net_offset(const LoopStmt& stmt);
+
+    bool is_balanced(const LoopStmt& stmt);
+
+    // offsets reached by the segment starting at stmt_list
+    HeadExtent segment_extent(const FullStmtList* stmt_list);
+
+    void visit(const Program* prog) override {}
+
+    void visit(const FullStmtList& stmt_list) override {}
+
+    void visit(const LeftStmt& stmt) override;
+
+    void visit(const RightStmt& stmt) override;
+
+    void visit(const IncStmt& stmt) override {}
+
+    void visit(const DecStmt& stmt) override {}
+
+    void visit(const ReadStmt& stmt) override {}
+
+    void visit(const PrintStmt& stmt) override {}
+
+    void visit(const LoopStmt& stmt) override;
+
+protected:
+    struct Walk {
+        long offset = 0;
+        HeadExtent extent;
+        bool stopped = false; // at an unbalanced loop
+    };
+
+    // walks the segment starting at stmt_list
+    Walk walk(const FullStmtList* stmt_list);
+
+    Walk walk_;
+
+    std::unordered_map<const LoopStmt*, std::optional<long>> loop_net_offsets_;
+};
@@ -6,25 +6,17 @@
 #include <utility>
 #include <stdexcept>
 #include <variant>
+#include <iterator>
+#include <thread>
+#include <vector>
 
-#include <llvm/IR/IRBuilder.h>
-#include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/Module.h>
-
-//#include <llvm-c/Analysis.h>
-#include <llvm/IR/Verifier.h>
-
-#include <llvm/Support/TargetSelect.h> // for initialization functions
-#include <llvm/Bitcode/BitcodeWriter.h>
-#include <llvm/Support/CodeGen.h>
+#include <llvm/TargetParser/Host.h>
 
 #include "argparse/argparse.hpp"
 
-#include "parser.hpp"
-#include "ast.hpp"
-#include "generator.hpp"
-#include "ostream_to_llvm_raw_pwrite_stream_adaptor.hpp"
-#include "output.hpp"
+#include "compiler.hpp"
+#include "compile_server.hpp"
+#include "batch_runner.hpp"
 
 template <typename T> requires std::is_same_v<T, std::istream> || std::is_same_v<T, std::ostream>
 int open_fstream_overwrite_ptr(const std::string& file_name, std::unique_ptr<std::fstream>& managed, T** ptr_to_unmanaged, const std::ios_base::openmode& mode) {
@@ -63,6 +55,55 @@ int main(int argc, char* argv[]) {
     arg_parser.add_hidden_alias_for(arg_parser.add_argument("-l", "--llvm-ir", "--emit-llvm")
         .help("Emit LLVM IR")
         .flag(), "-emit-llvm");
+    arg_parser.add_argument("--checked")
+        .help("Trap with a diagnostic rather than moving the tape head out of bounds")
+        .flag();
+    arg_parser.add_argument("--eval-budget")
+        .help("Steps to run the input free prefix of the program for at compile time, 0 disables compile time evaluation")
+        .default_value(PartialEvaluator::DEFAULT_STEP_BUDGET)
+        .scan<'u', size_t>();
+    arg_parser.add_argument("--chunk-size")
+        .help("Statements per generated function, beyond which the program is split into several functions, 0 keeps the whole program in main")
+        .default_value(Generator::DEFAULT_CHUNK_SIZE)
+        .scan<'u', size_t>();
+    arg_parser.add_argument("-j", "--jobs")
+        .help("Threads to split object code generation over")
+        .default_value(1u)
+        .scan<'u', unsigned>();
+
+    arg_parser.add_group("Target Selection Options");
+    arg_parser.add_argument("--target")
+        .help("Generate code for the given target triple")
+        .default_value(llvm::sys::getDefaultTargetTriple());
+    arg_parser.add_argument("-mcpu", "-march")
+        .help("Target a specific cpu type, \"native\" selects the host cpu and its features")
+        .default_value(std::string("generic"));
+    arg_parser.add_argument("-mattr")
+        .help("Target specific attributes, e.g. \"+avx2,+bmi\"")
+        .default_value(std::string(""));
+
+    arg_parser.add_group("Compile Server Options");
+    arg_parser.add_argument("--server")
+        .help("Run a compile server, which other invocations of bfc will use when it is running")
+        .flag();
+    arg_parser.add_argument("--no-server")
+        .help("Always compile in this process, even if a compile server is running")
+        .flag();
+    arg_parser.add_argument("--server-socket")
+        .help("Unix domain socket of the compile server [default: $BFC_SERVER_SOCKET, $XDG_RUNTIME_DIR/bfc.sock or /tmp/bfc-<uid>/server.sock]")
+        .default_value(default_server_socket_path());
+
+    arg_parser.add_group("Batch Options");
+    arg_parser.add_argument("--run-batch")
+        .help("Run the program once per input file, each with the file as its stdin, instead of compiling it")
+        .nargs(argparse::nargs_pattern::at_least_one);
+    arg_parser.add_argument("--batch-dir")
+        .help("Directory to write each run's <input name>.stdout and <input name>.stderr to")
+        .default_value(std::string("."));
+    arg_parser.add_argument("--batch-jobs")
+        .help("Runs to execute at a time [default: number of cores]")
+        .default_value(std::thread::hardware_concurrency())
+        .scan<'u', unsigned>();
 
     arg_parser.add_argument("input")
         .help("Input file name")
@@ -76,6 +117,12 @@ int main(int argc, char* argv[]) {
         std::exit(1);
     }
 
+    // run as a compile server until killed
+    if (arg_parser.get<bool>("--server")) {
+        CompileServer server (arg_parser.get<std::string>("--server-socket"));
+        return server.run(std::thread::hardware_concurrency());
+    }
+
     // input file
     const std::string input_file_name = arg_parser.get<std::string>("input");
 
@@ -92,19 +139,59 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // parse input code
-    Parser parser (*input_ptr); 
-    std::unique_ptr<Program> program = parser.parse();
-    //std::cerr << static_cast<std::string>(*program) << '\n';
+    // read input code
+    std::string source {std::istreambuf_iterator<char>(*input_ptr), std::istreambuf_iterator<char>()};
+
+    // select the output type
+    Compiler::Options options;
+    options.target_triple = arg_parser.get<std::string>("--target");
+    options.cpu = arg_parser.get<std::string>("-mcpu");
+    options.features = arg_parser.get<std::string>("-mattr");
+    options.checked = arg_parser.get<bool>("--checked");
+    options.evaluation_budget = arg_parser.get<size_t>("--eval-budget");
+    options.chunk_size = arg_parser.get<size_t>("--chunk-size");
+    options.codegen_threads = arg_parser.get<unsigned>("--jobs");
+
+    // compile once, in process, then run over every input
+    if (arg_parser.is_used("--run-batch")) {
+        try {
+            BatchRunner runner (arg_parser.get<std::string>("--batch-dir"), arg_parser.get<unsigned>("--batch-jobs"));
+            runner.compile(source, options);
+            return runner.run(arg_parser.get<std::vector<std::string>>("--run-batch")) > 0 ? 1 : 0;
+        } catch (const std::exception& err) {
+            std::cerr << err.what() << '\n';
+            return 1;
+        }
+    }
 
-    // generate llvm module
-    Generator generator;
-    program->accept(generator);
-    llvm::Module& module_ = generator.get_module();
+    if (arg_parser.get<bool>("--emit-llvm")) {
+        options.output_type = arg_parser.get<bool>("--asm") ? Compiler::OutputType::LLVM_IR : Compiler::OutputType::LLVM_BITCODE;
+    } else if (arg_parser.get<bool>("--asm")) {
+        options.output_type = Compiler::OutputType::ASSEMBLY;
+    } else if (arg_parser.get<bool>("--compile")) {
+        options.output_type = Compiler::OutputType::OBJECT;
+    } else {
+        std::cout << "TODO\n";
+        return 0;
+    }
+
+    // compile, preferring a running compile server over starting up llvm here
+    std::string output;
+    try {
+        std::optional<std::string> served_output;
+        if (!arg_parser.get<bool>("--no-server")) {
+            CompileClient client (arg_parser.get<std::string>("--server-socket"));
+            served_output = client.compile(source, options);
+        }
 
-    // verify module
-    if (llvm::verifyModule(module_, &llvm::errs())) {
-        std::cerr << "Generated module has errors";
+        if (served_output) {
+            output = std::move(*served_output);
+        } else {
+            Compiler compiler;
+            output = compiler.compile(source, options);
+        }
+    } catch (const std::exception& err) {
+        std::cerr << err.what() << '\n';
         return 1;
     }
 
@@ -117,33 +204,9 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // generate final output
-    if (arg_parser.get<bool>("--emit-llvm")) {
-        OStreamToLLVMRawPWriteStreamAdaptor llvm_output {output_ptr};
-        if (arg_parser.get<bool>("--asm")) {
-            module_.print(llvm_output, nullptr); // write LLVM IR
-        } else {
-            llvm::WriteBitcodeToFile(module_, llvm_output); // llvm bitcode format obj files
-        }     
-
-        llvm_output.flush();
-    } else {
-
-        llvm::InitializeAllTargetInfos();
-        llvm::InitializeAllTargets();
-        llvm::InitializeAllTargetMCs();
-        llvm::InitializeAllAsmPrinters();
-
-        LLVMModuleEmitter emitter(module_, llvm::sys::getDefaultTargetTriple());
-
-        if (arg_parser.get<bool>("--asm")) {
-            emitter.emit(&std::cout, llvm::CodeGenFileType::CGFT_AssemblyFile);
-        } else if (arg_parser.get<bool>("--compile")) {
-            emitter.emit(&std::cout, llvm::CodeGenFileType::CGFT_ObjectFile);
-        } else {
-            std::cout << "TODO\n";
-        }
-    }
+    // write final output
+    output_ptr->write(output.data(), output.size());
+    output_ptr->flush();
 
     return 0;
 }
@@ -34,6 +34,7 @@
 
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/Triple.h>
 
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/Object/ObjectFile.h>
@@ -44,69 +45,108 @@
 #include <llvm/Passes/PassPlugin.h>
 
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringExtras.h>
 
 #include <lld/Common/Driver.h>
 
 class LLVMModuleEmitter {
 public:
+    // the target machine is borrowed, so that it can be reused across many modules
     LLVMModuleEmitter(
         llvm::Module& module_, 
-        std::string target_triple
+        llvm::TargetMachine& target_machine
     ) : 
         module_{module_}, 
-        target_triple_{target_triple}, 
-        target_{llvm::TargetRegistry::lookupTarget(target_triple, err_)}, 
-        target_opt_{}
+        target_machine_{target_machine}
     {
+        module_.setDataLayout(target_machine_.createDataLayout());
+        module_.setTargetTriple(target_machine_.getTargetTriple().str());
+    }
 
-        // target machine    
-        std::string err;
-        const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, err);
+    int emit(std::ostream* output_stream_ptr, llvm::CodeGenFileType file_type) {
+        OStreamToLLVMRawPWriteStreamAdaptor llvm_output_stream {output_stream_ptr};
+
+        return emit(llvm_output_stream, file_type);
+    }
+
+    int emit(llvm::raw_pwrite_stream& llvm_output_stream, llvm::CodeGenFileType file_type) {
+        llvm::legacy::PassManager pass_mgr;
+        if (target_machine_.addPassesToEmitFile(pass_mgr, llvm_output_stream, nullptr, file_type)) {
+            std::cerr << "TargetMachine can't emit a file of this type";
+            return 1;
+        }
+
+        pass_mgr.run(module_);
+        llvm_output_stream.flush();
+
+        return 0;
+    }
+
+    // returns nullptr and sets err if the target triple is unknown,
+    // or if the "native" cpu is requested for an architecture other than the host's
+    static std::unique_ptr<llvm::TargetMachine> create_target_machine(
+        const std::string& target_triple, 
+        const std::string& cpu, 
+        const std::string& features,
+        std::string& err
+    ) {
+        if (cpu == "native" && llvm::Triple(target_triple).getArch() != llvm::Triple(llvm::sys::getProcessTriple()).getArch()) {
+            err = "-march=native selects the host cpu, which cannot be used for target \"" + target_triple + "\"";
+            return nullptr;
+        }
 
+        const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, err);
         if (!target) {
-            std::cerr << err;
-            return;
+            return nullptr;
         }
 
+        llvm::TargetOptions target_opt;
         std::optional<llvm::Reloc::Model> reloc {llvm::Reloc::PIC_};
 
-        target_machine_ = target->createTargetMachine(
-            target_triple_, 
-            "generic",
-            "",
-            target_opt_, 
+        return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+            target_triple, 
+            resolve_cpu(cpu),
+            resolve_features(cpu, features),
+            target_opt, 
             reloc
-        );
+        ));
+    }
+
+    // "native" selects the cpu of the host, as with clang's -march=native,
+    // only meaningful for target triples with the host's architecture
+    static std::string resolve_cpu(const std::string& cpu) {
+        if (cpu == "native") {
+            return llvm::sys::getHostCPUName().str();
+        }
 
-        module_.setDataLayout(target_machine_->createDataLayout());
-        module_.setTargetTriple(target_triple_);
+        return cpu.empty() ? "generic" : cpu;
     }
 
-    int emit(std::ostream* output_stream_ptr, llvm::CodeGenFileType file_type) {
+    // with a native cpu, the host's features are enabled first, 
+    // so that any explicit -mattr features can still override them
+    static std::string resolve_features(const std::string& cpu, const std::string& features) {
+        if (cpu != "native") {
+            return features;
+        }
 
-        OStreamToLLVMRawPWriteStreamAdaptor llvm_output_stream {output_stream_ptr};
+        std::vector<std::string> feature_list;
 
-        llvm::legacy::PassManager pass_mgr;
-        if (target_machine_->addPassesToEmitFile(pass_mgr, llvm_output_stream, nullptr, file_type)) {
-            std::cerr << "TargetMachine can't emit a file of this type";
-            return 1;
+        llvm::StringMap<bool> host_features;
+        if (llvm::sys::getHostCPUFeatures(host_features)) {
+            for (const auto& feature : host_features) {
+                feature_list.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+            }
         }
 
-        pass_mgr.run(module_);
-        llvm_output_stream.flush();
+        if (!features.empty()) {
+            feature_list.push_back(features);
+        }
 
-        return 0;
+        return llvm::join(feature_list, ",");
     }
 
 protected:
     llvm::Module& module_;    
-
-    std::string err_;
-    const llvm::Target* target_;
-    llvm::TargetOptions target_opt_;
-
-    // target machine
-    std::string target_triple_;
-    llvm::TargetMachine* target_machine_;
-
+    llvm::TargetMachine& target_machine_;
 };
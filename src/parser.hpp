@@ -5,6 +5,7 @@
 #include <memory>
 #include <utility>
 #include <stdexcept>
+#include <vector>
 #include "ast.hpp"
 #include "debug_print.hpp"
 
@@ -39,10 +40,12 @@ protected:
     std::unique_ptr<StmtList> parseStmtList() {
         DEBUG_COUT << "parseStmtList \"" << c_ << "\"\n";
 
-        while (!file_.eof()) {
+        // collect the statements iteratively rather than recursing per statement, 
+        // so that long programs cannot overflow the stack
+        std::vector<std::unique_ptr<Stmt>> stmts;
+
+        while (!file_.eof() && c_ != ']') {
             switch(c_) {
-            case ']':
-                return std::unique_ptr<StmtList> (new EmptyStmtList());
             case '+':
             case '-':
             case '<':
@@ -50,7 +53,11 @@ protected:
             case '.':
             case ',': 
             case '[':
-                return parseFullStmtList();
+                stmts.push_back(parseStmt());
+                if (!stmts.back()) {
+                    throw std::runtime_error("Failed to parse Stmt while parsing a StmtList");
+                }
+                continue;
             default:
                 break;
             }
@@ -58,23 +65,13 @@ protected:
             next();
         }
 
-        return std::unique_ptr<StmtList> (new EmptyStmtList());
-    }
-
-    std::unique_ptr<StmtList> parseFullStmtList() {
-        DEBUG_COUT << "parseFullStmtList \"" << c_ << "\"\n";
-
-        std::unique_ptr<Stmt> stmt = parseStmt();
-        if (!stmt) {
-            throw std::runtime_error("Failed to parse Stmt while parsing a StmtList");
+        // link the statements, back to front
+        std::unique_ptr<StmtList> stmt_list (new EmptyStmtList());
+        for (auto it = stmts.rbegin(); it != stmts.rend(); ++it) {
+            stmt_list.reset(new FullStmtList(std::move(*it), std::move(stmt_list)));
         }
 
-        std::unique_ptr<StmtList> stmt_list = parseStmtList();
-        if (!stmt_list) {
-            throw std::runtime_error("Failed to parse StmtList (next) while parsing a StmtList");
-        }
-
-        return std::unique_ptr<StmtList> (new FullStmtList(std::move(stmt), std::move(stmt_list)));
+        return stmt_list;
     }
 
     std::unique_ptr<Stmt> parseStmt() {
@@ -93,8 +90,9 @@ protected:
         case '>':
             next();
             return std::unique_ptr<Stmt> (new RightStmt());
-        /*case ',':
-            return std::unique_ptr<Stmt> (new ReadStmt()); */
+        case ',':
+            next();
+            return std::unique_ptr<Stmt> (new ReadStmt());
         case '.':
             next();
             return std::unique_ptr<Stmt> (new PrintStmt()); 
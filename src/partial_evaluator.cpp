@@ -0,0 +1,118 @@
+#include "partial_evaluator.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+
+PartialEvaluator::PartialEvaluator(size_t tape_size, size_t step_budget) :
+    steps_left_{step_budget}
+{
+    evaluation_.tape.resize(tape_size, 0);
+}
+
+const PartialEvaluation& PartialEvaluator::get_evaluation() const {
+    return evaluation_;
+}
+
+void PartialEvaluator::visit(const Program* prog) {
+    evaluation_.residual = dynamic_cast<const FullStmtList*>(prog->stmt_list.get());
+
+    while (evaluation_.residual) {
+        const Stmt& stmt = *evaluation_.residual->stmt;
+
+        // a top-level statement either runs to completion, or not at all,
+        // only loops can halt part way through, the rest halt before changing anything
+        bool is_loop = dynamic_cast<const LoopStmt*>(&stmt) != nullptr;
+        size_t output_size = evaluation_.output.size();
+        size_t head = evaluation_.head;
+        if (is_loop) {
+            saved_tape_.assign(evaluation_.tape.begin(), evaluation_.tape.end());
+        }
+
+        stmt.accept(*this);
+
+        if (halted_) {
+            if (is_loop) {
+                evaluation_.output.resize(output_size);
+                evaluation_.tape.swap(saved_tape_);
+                evaluation_.head = head;
+            }
+            return;
+        }
+
+        evaluation_.residual = evaluation_.residual->next_full();
+    }
+}
+
+void PartialEvaluator::visit(const FullStmtList& stmt_list) {
+    for (const FullStmtList* it = &stmt_list; it && !halted_; it = it->next_full()) {
+        it->stmt->accept(*this);
+    }
+}
+
+void PartialEvaluator::visit(const LeftStmt& stmt) {
+    if (!step()) {
+        return;
+    }
+
+    // leaving the tape is left for the compiled program to do
+    if (evaluation_.head == 0) {
+        halted_ = true;
+        return;
+    }
+
+    --evaluation_.head;
+}
+
+void PartialEvaluator::visit(const RightStmt& stmt) {
+    if (!step()) {
+        return;
+    }
+
+    if (evaluation_.head + 1 >= evaluation_.tape.size()) {
+        halted_ = true;
+        return;
+    }
+
+    ++evaluation_.head;
+}
+
+void PartialEvaluator::visit(const IncStmt& stmt) {
+    if (step()) {
+        ++evaluation_.tape[evaluation_.head];
+    }
+}
+
+void PartialEvaluator::visit(const DecStmt& stmt) {
+    if (step()) {
+        --evaluation_.tape[evaluation_.head];
+    }
+}
+
+void PartialEvaluator::visit(const ReadStmt& stmt) {
+    // input is only known at run time
+    halted_ = true;
+}
+
+void PartialEvaluator::visit(const PrintStmt& stmt) {
+    if (step()) {
+        evaluation_.output.push_back(static_cast<char>(evaluation_.tape[evaluation_.head]));
+    }
+}
+
+void PartialEvaluator::visit(const LoopStmt& stmt) {
+    while (step() && evaluation_.tape[evaluation_.head] != 0) {
+        stmt.stmt_list->accept(*this);
+    }
+}
+
+bool PartialEvaluator::step() {
+    if (halted_ || steps_left_ == 0) {
+        halted_ = true;
+        return false;
+    }
+
+    --steps_left_;
+    return true;
+}
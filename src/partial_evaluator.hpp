@@ -0,0 +1,62 @@
+/*
+Runs the input free prefix of a program at compile time.
+
+Top-level statements are interpreted one at a time, until one reads input, leaves the tape, or runs
+out of the step budget. That statement, and everything after it, is the residual program, which is
+compiled as usual, starting from the evaluated tape state and after writing the evaluated output.
+*/
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "visitor.hpp"
+
+struct PartialEvaluation {
+    std::string output; // printed by the evaluated prefix
+    std::vector<uint8_t> tape;
+    size_t head = 0;
+    const FullStmtList* residual = nullptr; // first top-level statement left to run, or nullptr
+};
+
+class PartialEvaluator : public Visitor {
+public:
+    // statements and loop iterations to run before giving up, 
+    // small enough that a program with no evaluable prefix costs little to compile
+    static constexpr size_t DEFAULT_STEP_BUDGET = 100000;
+
+    PartialEvaluator(size_t tape_size, size_t step_budget = DEFAULT_STEP_BUDGET);
+
+    const PartialEvaluation& get_evaluation() const;
+
+    void visit(const Program* prog) override;
+
+    void visit(const FullStmtList& stmt_list) override;
+
+    void visit(const LeftStmt& stmt) override;
+
+    void visit(const RightStmt& stmt) override;
+
+    void visit(const IncStmt& stmt) override;
+
+    void visit(const DecStmt& stmt) override;
+
+    void visit(const ReadStmt& stmt) override;
+
+    void visit(const PrintStmt& stmt) override;
+
+    void visit(const LoopStmt& stmt) override;
+
+protected:
+    // counts a step, halting once the budget is spent
+    bool step();
+
+    PartialEvaluation evaluation_;
+
+    size_t steps_left_;
+    bool halted_ = false;
+
+    // the tape before the top-level loop being run, reused to avoid allocating per loop
+    std::vector<uint8_t> saved_tape_;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+struct Program;
+struct FullStmtList;
+struct LeftStmt;
+struct RightStmt;
+struct IncStmt;
+struct DecStmt;
+struct ReadStmt;
+struct PrintStmt;
+struct LoopStmt;
+
+// implemented by everything that walks the AST, e.g. the Generator
+class Visitor {
+public:
+    virtual ~Visitor() = default;
+
+    virtual void visit(const Program* prog) = 0;
+
+    virtual void visit(const FullStmtList& stmt_list) = 0;
+
+    virtual void visit(const LeftStmt& stmt) = 0;
+
+    virtual void visit(const RightStmt& stmt) = 0;
+
+    virtual void visit(const IncStmt& stmt) = 0;
+
+    virtual void visit(const DecStmt& stmt) = 0;
+
+    virtual void visit(const ReadStmt& stmt) = 0;
+
+    virtual void visit(const PrintStmt& stmt) = 0;
+
+    virtual void visit(const LoopStmt& stmt) = 0;
+};
@@ -0,0 +1,41 @@
+// compile time checks for include/bfc/constexpr.hpp, built by `make check`
+#include <bfc/constexpr.hpp>
+#include <cstddef>
+#include <string_view>
+
+#define A_CHAR "+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++" // 65 +, i.e. "A" from a zeroed cell
+
+static_assert(bfc::evaluate<"++++++++[>++++[>++>+++>+++>+<<<<-]>+>+>->>+[<]<-]>>.>---.+++++++..+++.>>.<-.<.+++.------.--------.>>+.>++.">().view()
+    == "Hello World!\n");
+
+// both clears are recognised, and leave the cell at zero
+static_assert(bfc::evaluate<"+++[-]" A_CHAR ".">().view() == "A");
+static_assert(bfc::evaluate<"+++[+]" A_CHAR ".">().view() == "A");
+
+static_assert(bfc::evaluate<"">().view().empty());
+static_assert(bfc::evaluate<"comments only">().view().empty());
+
+// folded runs which cancel out, including across comments
+static_assert(bfc::evaluate<"+-+ -" A_CHAR ".><.">().view() == "AA");
+static_assert(bfc::evaluate<"++--" A_CHAR ">+<-+.">().view() == "A");
+
+// wraps around, as the compiled program does
+static_assert(bfc::evaluate<"-.">().view() == "\xff");
+
+// input is available at compile time through run
+constexpr bool echoes_input() {
+    constexpr std::string_view input = "bfc";
+    size_t read = 0;
+    char output[4] {};
+    size_t written = 0;
+
+    bfc::tape<> tape;
+    bfc::program<",[.,]">::run(
+        tape,
+        [&]() -> int { return read < input.size() ? input[read++] : -1; },
+        [&](char c) { output[written++] = c; }
+    );
+
+    return std::string_view(output, written) == input;
+}
+static_assert(echoes_input());
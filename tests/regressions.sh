@@ -0,0 +1,71 @@
+#!/bin/bash
+# regression cases, run by `make check`, needs `lli` to run the generated IR
+
+BFC="${BFC:-bin/bfc}"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+FAILED=0
+
+# the program must print the expected output, both with and without compile time evaluation
+expect_output() {
+    local name="$1" program="$2" input="$3" expected="$4"
+
+    printf '%s' "$program" > "$TMP/program.bf"
+    for budget_flag in "" "--eval-budget=0"; do
+        if ! "$BFC" --no-server $budget_flag -lS -o "$TMP/program.ll" "$TMP/program.bf"; then
+            echo "FAIL: $name: failed to compile ${budget_flag:-with evaluation}"
+            FAILED=1
+            return
+        fi
+
+        if ! printf '%s' "$input" | lli "$TMP/program.ll" > "$TMP/stdout" \
+            || [ "$(cat "$TMP/stdout")" != "$expected" ]; then
+            echo "FAIL: $name: printed \"$(cat "$TMP/stdout")\" ${budget_flag:-with evaluation}, expected \"$expected\""
+            FAILED=1
+            return
+        fi
+    done
+
+    echo "ok: $name"
+}
+
+# with --checked, the program must trap with bfc's diagnostic rather than run off the tape
+expect_trap() {
+    local name="$1" program="$2" input="$3"
+
+    printf '%s' "$program" > "$TMP/program.bf"
+    if ! "$BFC" --no-server --checked -lS -o "$TMP/program.ll" "$TMP/program.bf"; then
+        echo "FAIL: $name: failed to compile"
+        FAILED=1
+        return
+    fi
+
+    if printf '%s' "$input" | lli "$TMP/program.ll" > /dev/null 2> "$TMP/stderr" \
+        || ! grep -q "bfc: tape head moved out of bounds" "$TMP/stderr"; then
+        echo "FAIL: $name: did not trap"
+        FAILED=1
+        return
+    fi
+
+    echo "ok: $name"
+}
+
+# 65 +, i.e. "A" from a zeroed cell
+A="$(printf '+%.0s' {1..65})"
+
+expect_output "input free program" '++++++++[>++++++++<-]>+.+.' '' 'AB'
+expect_output "prefix stopped by input" "${A}.>,.<+." 'z' 'AzB'
+# counts 255 outer iterations into the second cell, each long enough that the budget runs out part way through one
+expect_output "prefix stopped by the step budget" "-[>+>-[>-[-]<-]<<-]>${A}+." '' 'A'
+
+# these read first, so that the cells' values are tracked through compiled code rather than evaluated
+expect_output "redundant clear after a loop" ",[-][-]${A}." 'x' 'A'
+expect_output "loop on a cell of unknown value" ",[>${A}.<[-]]" 'x' 'A'
+expect_output "runs of +/- on known cells" ",>${A}.+.--.<." 'x' 'AB@x'
+expect_output "known cell kept across a balanced loop" ",>${A}<[-]>.+." 'x' 'AB'
+
+expect_trap "moving off the tape after a loop" ',[-]<<<<<+.' 'a'
+expect_trap "moving off the tape after a removed dead loop" ',[-][>]<<<<<+.' 'a'
+
+exit $FAILED